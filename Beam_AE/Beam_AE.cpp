@@ -30,6 +30,7 @@ kernel BlinkBeam : ImageComputationKernel<ePixelWise>
     float _time;
     bool horizontal;
     bool vertical;
+    int4 box;
 
 
   void define() {
@@ -81,6 +82,21 @@ kernel BlinkBeam : ImageComputationKernel<ePixelWise>
     anim_start = start + direction * start_dist;
     anim_end = start + direction * end_dist;
 
+
+    // ---------- Beam bounding box ----------
+
+    // Width grows linearly along the beam, so past either end it can outgrow the distance to that end
+    // by at most full_length / ( full_length - width change ). If it grows faster than that, use the whole image
+    float width_change = fabs( end_width - start_width );
+    float end_reach = max( fabs( start_width + start_dist * ( end_width - start_width ) ), fabs( start_width + end_dist * ( end_width - start_width ) ) );
+    if ( full_length > width_change ) {
+      float reach = end_reach * full_length / ( full_length - width_change ) + 1.0f;
+      box = int4( floor( min( anim_start.x, anim_end.x ) - reach ), floor( min( anim_start.y, anim_end.y ) - reach ),
+                  ceil( max( anim_start.x, anim_end.x ) + reach ), ceil( max( anim_start.y, anim_end.y ) + reach ) );
+    } else {
+      box = int4( dst.bounds.x1, dst.bounds.y1, dst.bounds.x2, dst.bounds.y2 );
+    }
+
   }
 
 
@@ -124,6 +140,14 @@ kernel BlinkBeam : ImageComputationKernel<ePixelWise>
 
 
   void process( int2 pos ) {
+
+    // Nothing to draw outside the beam's bounding box
+    if ( pos.x < box.x || pos.y < box.y || pos.x > box.z || pos.y > box.w ) {
+      for ( int component = 0; component <= 3; component++ ) {
+        dst( component ) = 0.0f;
+      }
+      return;
+    }
     
     // -------- Beam appearance ---------
 
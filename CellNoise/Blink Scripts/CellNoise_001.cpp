@@ -0,0 +1,703 @@
+// https://aftbit.com/cell-noise-2/
+// Combined Euclidian, Manhattan, Chebyshev, Worley and Voronoi noise
+
+# define MAX_DISTANCE_ARRAY 12
+# define FEATURE_CACHE_SIZE 32768
+# define NEIGHBOURS 27
+# define EVOLVE_RADIUS 0.15f
+
+// Distance metrics
+# define METRIC_EUCLIDIAN 0
+# define METRIC_MANHATTAN 1
+# define METRIC_CHEBYSHEV 2
+# define METRIC_LENGTH 3
+
+// Output modes, the range between F(n) and F1, the nearest distance only, or a colour per cell
+# define MODE_RANGE 0
+# define MODE_F1 1
+# define MODE_CELL_ID 2
+
+// Gradient writes the screen space gradient of the Range or F1 noise to rg and the noise to b
+// Show Cost writes the cubes hashed, cubes searched and points inserted per pixel to rgb, for benchmarking
+// Voronoi with Cell Channels writes F1, F2, F2 - F1 and the nearest cell id to rgba instead of a colour
+
+// Noise types :
+// Worley    = METRIC_LENGTH, MODE_F1 ( Invert for Worley Inverse )
+// Voronoi   = METRIC_LENGTH, MODE_CELL_ID
+// Euclidian = METRIC_EUCLIDIAN, MODE_RANGE
+// Manhattan = METRIC_MANHATTAN, MODE_RANGE
+// Chebyshev = METRIC_CHEBYSHEV, MODE_RANGE
+
+// C++11
+const uint rand_multiplier = 48271;
+const uint rand_increment  = 0;
+const uint rand_modulus    = 2147483647;
+
+static int lcgRandom(int seed)
+{
+  return abs((seed * rand_multiplier + rand_increment) % rand_modulus);
+}
+
+// FNV Hash
+const uint OFFSET_BASIS = 2166136261;
+const uint FNV_PRIME = 16777619;
+
+static uint hash(uint i, uint j, uint k)
+{
+  return ((((((OFFSET_BASIS ^ i) * FNV_PRIME) ^ j) * FNV_PRIME) ^ k) * FNV_PRIME);
+}
+
+// Poisson Distribution
+const uint one   =  393325350;
+const uint two   = 1022645910;
+const uint three = 1861739990;
+const uint four  = 2700834071;
+const uint five  = 3372109335;
+const uint six   = 3819626178;
+const uint seven = 4075350088;
+const uint eight = 4203212043;
+
+// Counts the thresholds passed rather than branching, so neighbouring pixels never diverge
+static uint probLookup(uint value)
+{
+  return 1 + uint(value >= one) + uint(value >= two) + uint(value >= three) + uint(value >= four)
+           + uint(value >= five) + uint(value >= six) + uint(value >= seven) + uint(value >= eight);
+}
+
+// Feature point offset of a cube in xyz and the number of feature points in w.
+// Every point is generated from the cube id, so all of a cube's points are the same
+static float4 cubeFeature(int id)
+{
+  float4 feature;
+  int lastRandom = lcgRandom(id);
+  feature.x = float(lastRandom) / rand_modulus;
+
+  lastRandom = lcgRandom(lastRandom);
+  feature.y = float(lastRandom) / rand_modulus;
+
+  lastRandom = lcgRandom(lastRandom);
+  feature.z = float(lastRandom) / rand_modulus;
+
+  feature.w = float(probLookup(id));
+  return feature;
+}
+
+// Position of an evolving point on one axis, at u when phase is 0.
+// The radius shrinks to a fifth of the gap to the nearer cube face, so a point only ever moves a fraction of its
+// distance from the face. The points stay about as evenly spread as the static ones instead of bunching up on the faces
+static float evolveAxis(float u, float start, float phase)
+{
+  float radius = min(EVOLVE_RADIUS, 0.2f * min(u, 1.0f - u));
+  return u + radius * (sin(start + phase) - sin(start));
+}
+
+// Distance Functions
+static float EuclidianDistanceFunc(float3 p1, float3 p2)
+{
+  return (p1.x - p2.x) * (p1.x - p2.x) + (p1.y - p2.y) * (p1.y - p2.y) + (p1.z - p2.z) * (p1.z - p2.z);
+}
+
+static float ManhattanDistanceFunc(float3 p1, float3 p2)
+{
+  return fabs(p1.x - p2.x) + fabs(p1.y - p2.y) + fabs(p1.z - p2.z);
+}
+
+static float ChebyshevDistanceFunc(float3 p1, float3 p2)
+{
+  float3 diff = p1 - p2;
+  return max(max(fabs(diff.x), fabs(diff.y)), fabs(diff.z));
+}
+
+
+// Insertion Array, only keeping entries up to last
+// Every entry is selected from its neighbour, the value or itself instead of breaking out early,
+// so the loop is the same length for every pixel. The value goes in front of any equal entries
+static void insert(float arr[], float value, int last)
+{
+  for (int i = last; i > 0; i--)
+    arr[i] = value <= arr[i - 1] ? arr[i - 1] : min(value, arr[i]);
+  arr[0] = min(value, arr[0]);
+}
+
+// Insertion Array, keeping the cell id alongside each distance
+static void insertID(float arr[], int idArr[], float value, int id, int last)
+{
+  for (int i = last; i > 0; i--)
+  {
+    bool shift = value <= arr[i - 1];
+    bool place = value <= arr[i];
+    idArr[i] = shift ? idArr[i - 1] : place ? id : idArr[i];
+    arr[i] = shift ? arr[i - 1] : place ? value : arr[i];
+  }
+  idArr[0] = value <= arr[0] ? id : idArr[0];
+  arr[0] = min(value, arr[0]);
+}
+
+// Insertion Array, keeping the feature point alongside each distance
+static void insertPoint(float arr[], float3 pointArr[], float value, float3 point, int last)
+{
+  for (int i = last; i > 0; i--)
+  {
+    bool shift = value <= arr[i - 1];
+    bool place = value <= arr[i];
+    pointArr[i] = shift ? pointArr[i - 1] : place ? point : pointArr[i];
+    arr[i] = shift ? arr[i - 1] : place ? value : arr[i];
+  }
+  pointArr[0] = value <= arr[0] ? point : pointArr[0];
+  arr[0] = min(value, arr[0]);
+}
+
+
+// Blink Kernel
+kernel CellNoise : ImageComputationKernel<ePixelWise>
+{
+  Image<eRead, eAccessRandom> baked;
+  Image<eWrite> dst;
+
+  param:
+    int metric;
+    int mode;
+    bool flat;
+    bool invert;
+    float range;
+    int seed;
+    int period;
+    bool use_baked;
+    int baked_resolution;
+    bool cell_channels;
+    bool gradient;
+    bool antialias;
+    int aa_samples;
+    bool show_cost;
+    bool evolve;
+    float time;
+    float speed;
+    int octaves;
+    float lacunarity;
+    float octave_gain;
+    float gain;
+    float gamma;
+    float4 dark_col;
+    float4 light_col;
+    float4x4 transform;
+
+  local:
+    float fRange;
+    int iRange;
+    float4x4 transform_inv;
+    float z;
+    float aaReach;
+    float evolvePhase;
+    int kth;
+    int neighbours;
+    int3 cubeOrder[NEIGHBOURS];
+    bool useCache;
+    int3 cacheMin;
+    int3 cacheSize;
+    int cacheId[FEATURE_CACHE_SIZE];
+    float4 cacheFeature[FEATURE_CACHE_SIZE];
+
+  void define()
+  {
+    defineParam(metric, "Metric", 0);
+    defineParam(mode, "Mode", 0);
+    defineParam(flat, "2D", false);
+    defineParam(invert, "Invert", false);
+    defineParam(range, "Range", 3.0f);
+    defineParam(seed, "Seed", 0);
+    defineParam(period, "Tile Period", 0);
+    defineParam(use_baked, "Use Baked", false);
+    defineParam(baked_resolution, "Baked Resolution", 1024);
+    defineParam(cell_channels, "Cell Channels", false);
+    defineParam(gradient, "Gradient", false);
+    defineParam(antialias, "Anti-aliasing", false);
+    defineParam(aa_samples, "AA Samples", 3);
+    defineParam(show_cost, "Show Cost", false);
+    defineParam(evolve, "Evolve", false);
+    defineParam(time, "Time", 0.0f);
+    defineParam(speed, "Evolve Speed", 0.1f);
+    defineParam(octaves, "Octaves", 1);
+    defineParam(lacunarity, "Lacunarity", 2.0f);
+    defineParam(octave_gain, "Octave Gain", 0.5f);
+    defineParam(gain, "Gain", 1.0f);
+    defineParam(gamma, "Gamma", 1.0f);
+    defineParam(dark_col, "Dark Colour", float4(0.0f, 0.0f, 0.0f, 1.0f));
+    defineParam(light_col, "Light Colour", float4(1.0f, 1.0f, 1.0f, 1.0f));
+  }
+
+  void init()
+  {
+    fRange = clamp(range, 0.0f, float(MAX_DISTANCE_ARRAY - 2));
+    iRange = int(fRange);
+    transform_inv = transform.invert();
+    z = transform_inv[2][3];
+
+    // Each point loops around its cube once every 1 / speed of time, see evolveFeature
+    evolvePhase = 2.0f * atan2(0.0f, -1.0f) * time * speed;
+
+    // How far F2 - F1 can change across a pixel, twice the radius of the pixel in noise space
+    float3 stepX = float3(transform_inv[0][0], transform_inv[1][0], transform_inv[2][0]);
+    float3 stepY = float3(transform_inv[0][1], transform_inv[1][1], transform_inv[2][1]);
+    aaReach = antialias ? length(stepX) + length(stepY) : 0.0f;
+
+    // Deepest entry of the distance array the output reads, nothing past it is kept
+    if (mode == MODE_F1)
+      kth = 0;
+    else if (mode == MODE_CELL_ID)
+      kth = cell_channels ? 1 : iRange;
+    else
+      kth = fmod(fRange, 1.0f) == 0.0f ? iRange + 1 : iRange + 2;
+
+    // Home cube first, then the faces, edges and corners, so the nearest points are usually found first.
+    // 2D noise only needs the 3x3 square of cubes at z = 0
+    int order = 0;
+    for (int shell = 0; shell < 4; shell++)
+    {
+      for (int i = -1; i < 2; ++i)
+      {
+        for (int j = -1; j < 2; ++j)
+        {
+          for (int k = -1; k < 2; ++k)
+          {
+            if (abs(i) + abs(j) + abs(k) == shell && !(flat && k != 0))
+              cubeOrder[order++] = int3(i, j, k);
+          }
+        }
+      }
+    }
+    neighbours = order;
+
+    // Cubes covered by the frame, a pixel past each edge for the anti-aliasing samples, and the neighbour on each side
+    // every search reads. A flat transform only needs the three layers around z. Pixels that round onto a cube outside
+    // still hash it themselves
+    float3 low = float3(1e30f, 1e30f, 1e30f);
+    float3 high = float3(-1e30f, -1e30f, -1e30f);
+    for (int corner = 0; corner < 4; corner++)
+    {
+      float3 point = float3(float(corner % 2 ? dst.bounds.x2 : dst.bounds.x1 - 1), float(corner < 2 ? dst.bounds.y1 - 1 : dst.bounds.y2), z);
+      point = multVectMatrix(point, transform_inv);
+      low = min(low, point);
+      high = max(high, point);
+    }
+    cacheMin = int3(floor(low.x) - 1, floor(low.y) - 1, floor(low.z) - 1);
+    cacheSize = int3(floor(high.x) + 2, floor(high.y) + 2, floor(high.z) + 2) - cacheMin;
+    if (flat)
+    {
+      cacheMin.z = 0;
+      cacheSize.z = 1;
+    }
+
+    // Hash every cube once up front when they fit in the cache, otherwise each pixel hashes its own.
+    // Only the first octave's cubes are cached, finer octaves cover many more
+    useCache = !use_baked && float(cacheSize.x) * float(cacheSize.y) * float(cacheSize.z) <= FEATURE_CACHE_SIZE;
+    if (useCache)
+    {
+      for (int slot = 0; slot < cacheSize.x * cacheSize.y * cacheSize.z; slot++)
+      {
+        int cubeX = cacheMin.x + slot % cacheSize.x;
+        int cubeY = cacheMin.y + (slot / cacheSize.x) % cacheSize.y;
+        int cubeZ = cacheMin.z + slot / (cacheSize.x * cacheSize.y);
+        cacheId[slot] = cubeId(cubeX, cubeY, cubeZ, 0);
+        cacheFeature[slot] = evolveFeature(cubeFeature(cacheId[slot]));
+      }
+    }
+  }
+
+  static float3 multVectMatrix(float3 vec, float4x4 M)
+  {
+    float3 out = float3(
+      vec.x * M[0][0] + vec.y * M[0][1] + vec.z * M[0][2] + M[0][3],
+      vec.x * M[1][0] + vec.y * M[1][1] + vec.z * M[1][2] + M[1][3],
+      vec.x * M[2][0] + vec.y * M[2][1] + vec.z * M[2][2] + M[2][3]
+    );
+
+    return out;
+  }
+
+  // Metric and mode are the same for every pixel, so these branches never diverge
+  float distanceFunc(float3 p1, float3 p2)
+  {
+    if (metric == METRIC_MANHATTAN)
+      return ManhattanDistanceFunc(p1, p2);
+    if (metric == METRIC_CHEBYSHEV)
+      return ChebyshevDistanceFunc(p1, p2);
+    if (metric == METRIC_LENGTH)
+      return length(p1 - p2);
+    return EuclidianDistanceFunc(p1, p2);
+  }
+
+  // Gradient of the distance with respect to p1 in noise space
+  float3 distanceGrad(float3 p1, float3 p2)
+  {
+    float3 diff = p1 - p2;
+    float3 signs = float3(float(diff.x > 0.0f) - float(diff.x < 0.0f), float(diff.y > 0.0f) - float(diff.y < 0.0f), float(diff.z > 0.0f) - float(diff.z < 0.0f));
+    if (metric == METRIC_MANHATTAN)
+      return signs;
+    if (metric == METRIC_CHEBYSHEV)
+    {
+      float3 dist = fabs(diff);
+      if (dist.x >= dist.y && dist.x >= dist.z)
+        return float3(signs.x, 0.0f, 0.0f);
+      if (dist.y >= dist.z)
+        return float3(0.0f, signs.y, 0.0f);
+      return float3(0.0f, 0.0f, signs.z);
+    }
+    if (metric == METRIC_LENGTH)
+      return diff / max(length(diff), 0.000001f);
+    return diff * 2.0f;
+  }
+
+  // Change in a distance of f1 from moving reach, in the metric's units
+  float edgeMargin(float f1, float reach)
+  {
+    if (metric == METRIC_EUCLIDIAN)
+      return 2.0f * sqrt(f1) * reach + reach * reach;
+    if (metric == METRIC_MANHATTAN)
+      return reach * 1.7320508f;
+    return reach;
+  }
+
+  // Lower bound of the distance to any point in a cube, from the gap to the cube on each axis
+  float boundFunc(float3 gap)
+  {
+    if (metric == METRIC_MANHATTAN)
+      return gap.x + gap.y + gap.z;
+    if (metric == METRIC_CHEBYSHEV)
+      return max(max(gap.x, gap.y), gap.z);
+    if (metric == METRIC_LENGTH)
+      return length(gap);
+    return gap.x * gap.x + gap.y * gap.y + gap.z * gap.z;
+  }
+
+  float4 getColour(float a) {
+    return dark_col * (1 - a) + light_col * a;
+  }
+
+  // Generate a reproducible random number for a cube, cubes repeat every period when tiling.
+  // Each octave hashes with its own seed, so finer octaves aren't scaled copies of the first lined up on the origin.
+  // Octave 0 keeps the plain seed and the pattern of older versions
+  int cubeId(int cubeX, int cubeY, int cubeZ, int octave)
+  {
+    if (period > 0)
+    {
+      cubeX = (cubeX % period + period) % period;
+      cubeY = (cubeY % period + period) % period;
+      cubeZ = (cubeZ % period + period) % period;
+    }
+    return lcgRandom(hash(cubeX, cubeY, cubeZ) ^ uint(seed) ^ (uint(octave) * FNV_PRIME));
+  }
+
+  // Bilinear lookup of the baked noise, which holds a single tile of period cubes square.
+  // The full resolution bake holds the noise at integer pixel positions, as process evaluates it, so texel i is
+  // noise at i there. A mip level's texel is centred on 1 / scale full resolution pixels, half a pixel off that
+  float4 sampleBaked(float3 input)
+  {
+    int bakedWidth = baked.bounds.width();
+    int bakedHeight = baked.bounds.height();
+    float scale = float(bakedWidth) / float(max(baked_resolution, 1));
+    float u = (input.x / float(max(period, 1)) * baked_resolution + 0.5f) * scale - 0.5f;
+    float v = (input.y / float(max(period, 1)) * baked_resolution + 0.5f) * scale - 0.5f;
+    int x0 = floor(u);
+    int y0 = floor(v);
+    float fx = u - x0;
+    float fy = v - y0;
+
+    // Wrap around the tile on both axes so there is no seam
+    int xa = (x0 % bakedWidth + bakedWidth) % bakedWidth + baked.bounds.x1;
+    int xb = ((x0 + 1) % bakedWidth + bakedWidth) % bakedWidth + baked.bounds.x1;
+    int ya = (y0 % bakedHeight + bakedHeight) % bakedHeight + baked.bounds.y1;
+    int yb = ((y0 + 1) % bakedHeight + bakedHeight) % bakedHeight + baked.bounds.y1;
+
+    float4 bottom = baked(xa, ya) * (1 - fx) + baked(xb, ya) * fx;
+    float4 top = baked(xa, yb) * (1 - fx) + baked(xb, yb) * fx;
+    return bottom * (1 - fy) + top * fy;
+  }
+
+  // Moves a cube's point around a small loop over time, leaving from and returning to its static position.
+  // The axes turn at whole multiples of the phase, so the motion repeats exactly every 1 / speed.
+  // The point never leaves its cube, so the hashing and neighbourhood don't change from frame to frame
+  float4 evolveFeature(float4 feature)
+  {
+    if (!evolve)
+      return feature;
+    float turn = 2.0f * atan2(0.0f, -1.0f);
+    float4 moved = feature;
+    moved.x = evolveAxis(feature.x, feature.y * turn, evolvePhase);
+    moved.y = evolveAxis(feature.y, feature.z * turn, -evolvePhase);
+    moved.z = evolveAxis(feature.z, feature.x * turn, evolvePhase * 2.0f);
+    return moved;
+  }
+
+  // Index of a cube in the cache, or -1 when it needs hashing
+  int cacheSlot(int cubeX, int cubeY, int cubeZ)
+  {
+    int3 cell = int3(cubeX, cubeY, cubeZ) - cacheMin;
+    if (!useCache || cell.x < 0 || cell.y < 0 || cell.z < 0 || cell.x >= cacheSize.x || cell.y >= cacheSize.y || cell.z >= cacheSize.z)
+      return -1;
+    return (cell.z * cacheSize.y + cell.y) * cacheSize.x + cell.x;
+  }
+
+  // Fills the distance array, and ids for MODE_CELL_ID or points for gradients, with the points nearest to input in noise space.
+  // With a reach for anti-aliasing, returns less than 0 when the edge between the two nearest cells is within reach.
+  // Adds the cubes hashed, cubes searched and points inserted to cost. Only octave 0 is cached
+  float search(float3 input, float reach, int octave, float distanceArray[], int idArray[], float3 pointArray[], float cost[])
+  {
+
+    //Declare some values for later use
+    int id, numberFeaturePoints, slot;
+    float3 featurePoint;
+    float4 feature;
+    int cubeX, cubeY, cubeZ;
+    float distance;
+    float cellF1 = 6666;
+    float cellF2 = 6666;
+
+    // Initialize values in distance array to large values
+    for (int i = 0; i <= kth; i++)
+    {
+        distanceArray[i] = 6666;
+        idArray[i] = 0;
+        pointArray[i] = input;
+    }
+
+    // Determine which cube the evaluation point is in
+    int evalCubeX = floor(input.x);
+    int evalCubeY = floor(input.y);
+    int evalCubeZ = floor(input.z);
+
+    float3 cubeFrac = input - float3(float(evalCubeX), float(evalCubeY), float(evalCubeZ));
+
+    for (int c = 0; c < neighbours; ++c)
+    {
+      int3 offset = cubeOrder[c];
+
+      // Skip cubes that can't hold a point nearer than the deepest distance used,
+      // the bound is shrunk slightly so rounding can never skip a cube that matters
+      float3 gap = float3(
+        offset.x < 0 ? cubeFrac.x : offset.x > 0 ? 1.0f - cubeFrac.x : 0.0f,
+        offset.y < 0 ? cubeFrac.y : offset.y > 0 ? 1.0f - cubeFrac.y : 0.0f,
+        offset.z < 0 ? cubeFrac.z : offset.z > 0 ? 1.0f - cubeFrac.z : 0.0f
+      );
+      float limit = distanceArray[kth];
+      if (reach > 0.0f)
+        limit = max(limit, cellF1 + edgeMargin(cellF1, reach));
+      if (boundFunc(gap) * 0.99999f > limit)
+        continue;
+
+      cost[1] += 1.0f;
+      cubeX = evalCubeX + offset.x;
+      cubeY = evalCubeY + offset.y;
+      cubeZ = evalCubeZ + offset.z;
+
+      // Generate a reproducible random number generator for the cube
+      slot = octave == 0 ? cacheSlot(cubeX, cubeY, cubeZ) : -1;
+      if (slot >= 0)
+      {
+        id = cacheId[slot];
+        feature = cacheFeature[slot];
+      }
+      else
+      {
+        cost[0] += 1.0f;
+        id = cubeId(cubeX, cubeY, cubeZ, octave);
+        feature = evolveFeature(cubeFeature(id));
+      }
+      featurePoint = float3(feature.x + float(cubeX), feature.y + float(cubeY), flat ? 0.0f : feature.z + float(cubeZ));
+
+      // Check each feature point, they share a position so the distance is only measured once.
+      // Most points are further than every kept distance and cost a single compare
+      distance = distanceFunc(input, featurePoint);
+
+      // Nearest two cells, each cube being a single cell
+      cellF2 = distance < cellF1 ? cellF1 : min(cellF2, distance);
+      cellF1 = min(cellF1, distance);
+
+      if (distance > distanceArray[kth])
+        continue;
+      // A cube's points all share a position, so for Voronoi cell channels a cube is one cell and F2 is the next cell
+      numberFeaturePoints = mode == MODE_CELL_ID && cell_channels ? 1 : int(feature.w);
+      cost[2] += numberFeaturePoints;
+      for (int l = 0; l < numberFeaturePoints; ++l)
+      {
+        // F1 only needs the nearest distance, no need to keep the rest sorted
+        if (mode == MODE_F1)
+        {
+          pointArray[0] = distance <= distanceArray[0] ? featurePoint : pointArray[0];
+          distanceArray[0] = min(distanceArray[0], distance);
+        }
+        else if (mode == MODE_CELL_ID)
+          insertID(distanceArray, idArray, distance, id, kth);
+        else if (gradient)
+          insertPoint(distanceArray, pointArray, distance, featurePoint, kth);
+        else
+          insert(distanceArray, distance, kth);
+      }
+    }
+
+    return cellF2 - cellF1 - edgeMargin(cellF1, reach);
+  }
+
+  // Noise value of a single octave before gain and gamma, a colour for MODE_CELL_ID
+  float3 octaveValue(float distanceArray[], int idArray[])
+  {
+    // Colour from the id of the nth nearest cell
+    if (mode == MODE_CELL_ID)
+    {
+      float3 col = float3(float(idArray[iRange]) / rand_modulus, 0.0f, 0.0f);
+      int lastRandom = lcgRandom(idArray[iRange]);
+      col.y = float(lastRandom) / rand_modulus;
+      lastRandom = lcgRandom(lastRandom);
+      col.z = float(lastRandom) / rand_modulus;
+      return col;
+    }
+
+    float color;
+    if (mode == MODE_F1)
+      color = invert ? 1.0f - distanceArray[0] : distanceArray[0];
+    else
+    {
+      // F(range + 2) is only kept when there is a fraction to blend with
+      float blend = fmod(fRange, 1.0f);
+      color = (blend > 0.0f ? (distanceArray[ iRange + 2 ] - distanceArray[ iRange + 1 ]) * blend : 0.0f) + distanceArray[ iRange + 1] - distanceArray[0];
+    }
+    return float3(color, color, color);
+  }
+
+  // Gradient of octaveValue in noise space, from the points behind each distance it reads
+  float3 octaveGrad(float3 input, float3 pointArray[])
+  {
+    if (mode == MODE_F1)
+      return distanceGrad(input, pointArray[0]) * (invert ? -1.0f : 1.0f);
+
+    float blend = fmod(fRange, 1.0f);
+    float3 grad = distanceGrad(input, pointArray[iRange + 1]) - distanceGrad(input, pointArray[0]);
+    if (blend > 0.0f)
+      grad += (distanceGrad(input, pointArray[iRange + 2]) - distanceGrad(input, pointArray[iRange + 1])) * blend;
+    return grad;
+  }
+
+  // Sum the octaves, each one finer and weaker than the last, normalised by the total weight.
+  // edge[0] is set when any octave has a cell edge within reach, grad[0] gets the noise space gradient
+  float3 fractal(float3 input, float reach, float edge[], float3 grad[], float cost[])
+  {
+    float distanceArray[MAX_DISTANCE_ARRAY];
+    int idArray[MAX_DISTANCE_ARRAY];
+    float3 pointArray[MAX_DISTANCE_ARRAY];
+
+    float3 total = float3(0.0f, 0.0f, 0.0f);
+    float weight = 0.0f;
+    float amplitude = 1.0f;
+    float frequency = 1.0f;
+    edge[0] = 0.0f;
+    grad[0] = float3(0.0f, 0.0f, 0.0f);
+    for (int octave = 0; octave < max(octaves, 1); octave++)
+    {
+      if (search(input * frequency, reach * frequency, octave, distanceArray, idArray, pointArray, cost) < 0.0f)
+        edge[0] = 1.0f;
+      total += octaveValue(distanceArray, idArray) * amplitude;
+      if (gradient && mode != MODE_CELL_ID)
+        grad[0] += octaveGrad(input * frequency, pointArray) * (amplitude * frequency);
+      weight += amplitude;
+      amplitude *= octave_gain;
+      frequency *= lacunarity;
+    }
+    grad[0] /= weight;
+    return total / weight;
+  }
+
+  // Final colour from the summed octaves
+  float4 shade(float3 total)
+  {
+    if (mode == MODE_CELL_ID)
+    {
+      float4 col;
+      for(int component = 0; component < 3; component++)
+        col[component] = pow( total[component] * gain, gamma);
+      col[3] = 1.0f;
+      return col;
+    }
+
+    float color = pow( total.x * gain, gamma );
+    return getColour(clamp(color, 0.0f, 1.0f));
+  }
+
+  // Noise space position of a point in the image
+  float3 noisePoint(float x, float y)
+  {
+    float3 input = multVectMatrix(float3(x, y, z), transform_inv);
+    if (flat)
+      input.z = 0.0f;
+    return input;
+  }
+
+  void process(int2 pos)
+  {
+    float distanceArray[MAX_DISTANCE_ARRAY];
+    int idArray[MAX_DISTANCE_ARRAY];
+    float3 pointArray[MAX_DISTANCE_ARRAY];
+    float edge[1];
+    float3 grad[1];
+    float cost[3];
+    for (int i = 0; i < 3; i++)
+      cost[i] = 0.0f;
+
+    float3 input = noisePoint(float(pos.x), float(pos.y));
+
+    // A texture lookup into noise baked with the same settings instead of searching the cubes
+    if (use_baked)
+    {
+      dst() = sampleBaked(input);
+      return;
+    }
+
+    // Raw distances and a cell id from a single search, for edges, cracks and per cell variation.
+    // The id is kept below 2^24 so it is an exact integer as a float
+    if (mode == MODE_CELL_ID && cell_channels)
+    {
+      search(input, 0.0f, 0, distanceArray, idArray, pointArray, cost);
+      dst(0) = distanceArray[0];
+      dst(1) = distanceArray[1];
+      dst(2) = distanceArray[1] - distanceArray[0];
+      dst(3) = float(idArray[0] % 16777216);
+      return;
+    }
+
+    float3 total = fractal(input, aaReach, edge, grad, cost);
+
+    // Chain the noise space gradient through the transform to pixels, then through gain and gamma
+    if (gradient && mode != MODE_CELL_ID)
+    {
+      float color = pow( total.x * gain, gamma );
+      float dx = grad[0].x * transform_inv[0][0] + grad[0].y * transform_inv[1][0] + grad[0].z * transform_inv[2][0];
+      float dy = grad[0].x * transform_inv[0][1] + grad[0].y * transform_inv[1][1] + grad[0].z * transform_inv[2][1];
+      float slope = total.x * gain > 0.0f ? gamma * pow( total.x * gain, gamma - 1.0f ) * gain : 0.0f;
+      dst(0) = dx * slope;
+      dst(1) = dy * slope;
+      dst(2) = clamp(color, 0.0f, 1.0f);
+      dst(3) = 1.0f;
+      return;
+    }
+
+    // Only pixels with a cell edge inside them are supersampled, on a grid of AA Samples squared
+    if (antialias && edge[0] > 0.0f)
+    {
+      int samples = max(aa_samples, 1);
+      float4 colour = float4(0.0f, 0.0f, 0.0f, 0.0f);
+      for (int sy = 0; sy < samples; sy++)
+      {
+        for (int sx = 0; sx < samples; sx++)
+        {
+          float3 sub = noisePoint(pos.x + (sx + 0.5f) / samples - 0.5f, pos.y + (sy + 0.5f) / samples - 0.5f);
+          colour += shade(fractal(sub, 0.0f, edge, grad, cost));
+        }
+      }
+      colour /= float(samples * samples);
+      dst() = show_cost ? float4(cost[0], cost[1], cost[2], 1.0f) : colour;
+      return;
+    }
+
+    dst() = show_cost ? float4(cost[0], cost[1], cost[2], 1.0f) : shade(total);
+
+  }
+
+};
\ No newline at end of file
@@ -0,0 +1,314 @@
+import nuke
+import hashlib
+import math
+import os
+import tempfile
+import time
+
+
+# Metric and mode of each of the old noise types, as listed at the top of CellNoise_001.cpp
+NOISE_VARIANTS = (
+    ( 'Worley',    3, 1 ),
+    ( 'Voronoi',   3, 2 ),
+    ( 'Euclidian', 0, 0 ),
+    ( 'Manhattan', 1, 0 ),
+    ( 'Chebyshev', 2, 0 ),
+)
+
+# CellNoise BlinkScript knobs are named after the kernel
+KERNEL = 'CellNoise'
+
+# Kernel params that change how the noise is read or reported rather than the noise itself
+BAKE_IGNORED = ( 'Use Baked', 'Baked Resolution', 'Show Cost' )
+
+
+def kernelNode( node ):
+    '''
+    Return the CellNoise BlinkScript node, either node itself or the one inside a Cell_Noise gizmo
+    '''
+    if node.knob( '%s_Metric' % KERNEL ):
+        return node
+    return node.node( KERNEL )
+
+
+def bakeKey( node, frame=None ):
+    '''
+    Return the name baked noise is cached under, from every kernel param that changes the output at frame,
+    including the transform that frames the tile
+    args:
+       node   - CellNoise BlinkScript node or Cell_Noise gizmo
+       frame  - frame the params are read at, defaults to the current frame
+    '''
+    frame = nuke.frame() if frame is None else frame
+    kernel = kernelNode( node )
+    settings = []
+    for name in sorted( kernel.knobs() ):
+        if not name.startswith( KERNEL + '_' ) or name[ len( KERNEL ) + 1: ] in BAKE_IGNORED:
+            continue
+        knob = kernel[ name ]
+        settings.append( '%s=%r' % ( name, [ knob.getValueAt( frame, index ) for index in range( knob.arraySize() ) ] ) )
+    return 'cellnoise_%s' % hashlib.md5( ';'.join( settings ).encode( 'utf-8' ) ).hexdigest()
+
+
+def bakePath( folder, key, level ):
+    '''
+    Return the file path of a mip level of baked noise, level 0 being full resolution
+    '''
+    return os.path.join( folder, '%s_mip%d.exr' % ( key, level ) )
+
+
+def bakeNoise( node, folder, key, resolution=1024, levels=4, frame=None ):
+    '''
+    Render a node once into a chain of mip levels on disk, each half the size of the last.
+    Levels that already exist for the key are reused rather than rendered again.
+    Sample them with Baked Resolution set to the same resolution
+    args:
+       node        - CellNoise node using a Tile Period, framed so one tile fills a resolution square format
+       folder      - folder the baked levels are cached in
+       key         - name from bakeKey()
+       resolution  - width and height of the full resolution level
+       levels      - number of mip levels to write
+       frame       - frame to render, defaults to the current frame
+    '''
+    frame = nuke.frame() if frame is None else frame
+    if node.width() != resolution or node.height() != resolution:
+        raise ValueError( '%s renders %dx%d, baking needs a %dx%d format' % ( node.name(), node.width(), node.height(), resolution, resolution ) )
+    if not os.path.isdir( folder ):
+        os.makedirs( folder )
+
+    paths = []
+    for level in range( levels ):
+        path = bakePath( folder, key, level )
+        paths.append( path )
+        if os.path.exists( path ):
+            continue
+
+        reformat = nuke.nodes.Reformat( type='scale', scale=0.5 ** level, inputs=[ node ] )
+        write = nuke.nodes.Write( file=path, file_type='exr', inputs=[ reformat ] )
+        write['datatype'].setValue( '32 bit float' )
+        try:
+            nuke.execute( write, frame, frame )
+        finally:
+            nuke.delete( write )
+            nuke.delete( reformat )
+    return paths
+
+
+def bakeSize( resolution, period ):
+    '''
+    Return the noise size that fits one tile of period cubes into a resolution wide format
+    '''
+    return resolution / float( period )
+
+
+def bakedLevel( size, resolution, period, levels=4 ):
+    '''
+    Return the mip level to sample for noise drawn at size, the coarsest level that still has
+    at least one texel per output pixel
+    '''
+    texelsPerPixel = bakeSize( resolution, period ) / float( size )
+    if texelsPerPixel <= 1.0:
+        return 0
+    return min( int( math.log( texelsPerPixel, 2 ) ), levels - 1 )
+
+
+def setKernelValue( node, param, value ):
+    '''
+    Set a CellNoise param by its label, on a BlinkScript node or the one inside a Cell_Noise gizmo
+    '''
+    kernelNode( node )[ '%s_%s' % ( KERNEL, param ) ].setValue( value )
+
+
+def setNoiseSize( node, size, rotate=0.0 ):
+    '''
+    Set the CellNoise transform to a uniform scale of size pixels per cube, rotated about z in degrees
+    '''
+    angle = math.radians( rotate )
+    matrix = ( size * math.cos( angle ), -size * math.sin( angle ), 0, 0,
+               size * math.sin( angle ),  size * math.cos( angle ), 0, 0,
+               0, 0, size, 0,
+               0, 0, 0, 1 )
+    knob = kernelNode( node )[ '%s_transform' % KERNEL ]
+    for index, value in enumerate( matrix ):
+        knob.setValue( value, index )
+
+
+def saveSettings( node ):
+    '''
+    Return the format and every CellNoise param of a node, values and expressions, for restoreSettings()
+    '''
+    kernel = kernelNode( node )
+    knobs = [ node[ 'format' ] ] + [ kernel[ name ] for name in sorted( kernel.knobs() ) if name.startswith( KERNEL + '_' ) ]
+    return [ ( knob, knob.toScript() ) for knob in knobs ]
+
+
+def restoreSettings( settings ):
+    '''
+    Put back the knobs saved by saveSettings()
+    '''
+    for knob, script in settings:
+        knob.fromScript( script )
+
+
+def sampleGrid( node, width, height, samples, channel='rgba.red', frame=None ):
+    '''
+    Return a channel of a node sampled at the centres of a samples x samples grid over the format
+    '''
+    frame = nuke.frame() if frame is None else frame
+    values = []
+    for j in range( samples ):
+        for i in range( samples ):
+            x = ( i + 0.5 ) * width / float( samples )
+            y = ( j + 0.5 ) * height / float( samples )
+            values.append( node.sample( channel, x, y, 1, 1, frame ) )
+    return values
+
+
+def renderTime( node, path, frame ):
+    '''
+    Render a node to an uncompressed exr and return the wall clock seconds taken
+    '''
+    write = nuke.nodes.Write( file=path, file_type='exr', inputs=[ node ] )
+    write['datatype'].setValue( '32 bit float' )
+    write['compression'].setValue( 'none' )
+    try:
+        start = time.time()
+        nuke.execute( write, frame, frame )
+        return time.time() - start
+    finally:
+        nuke.delete( write )
+
+
+def benchmarkNoise( node, formats=( 'square_512', 'HD_1080', 'UHD_4K' ), ranges=( 0, 1, 2 ),
+                    transforms=( ( 20.0, 0.0 ), ( 100.0, 30.0 ) ), samples=16, frame=None ):
+    '''
+    Render every noise variant over each format, range and transform, and print and return the results as
+    ( variant, width, height, range, size, rotate, megapixels per second, cubes hashed, cubes searched, points inserted ),
+    the costs being per pixel averages from Show Cost over a grid of samples.
+    The node's format and CellNoise params are put back afterwards
+    args:
+       node        - CellNoise BlinkScript node or Cell_Noise gizmo
+       formats     - names of existing formats to render at
+       ranges      - range values to render the range and Voronoi variants at
+       transforms  - ( size, rotate ) of each noise transform to render
+    '''
+    frame = nuke.frame() if frame is None else frame
+    folder = tempfile.mkdtemp( prefix='cellnoise_benchmark_' )
+    settings = saveSettings( node )
+    results = []
+    try:
+        for format in formats:
+            node['format'].setValue( format )
+            width, height = node.width(), node.height()
+            for variant, metric, mode in NOISE_VARIANTS:
+                setKernelValue( node, 'Metric', metric )
+                setKernelValue( node, 'Mode', mode )
+                for noise_range in ranges if mode != 1 else ranges[:1]:
+                    setKernelValue( node, 'Range', noise_range )
+                    for size, rotate in transforms:
+                        setNoiseSize( node, size, rotate )
+
+                        setKernelValue( node, 'Show Cost', False )
+                        seconds = renderTime( node, os.path.join( folder, '%s.exr' % variant ), frame )
+
+                        setKernelValue( node, 'Show Cost', True )
+                        cost = [ sum( sampleGrid( node, width, height, samples, 'rgba.%s' % channel, frame ) ) / samples ** 2
+                                 for channel in ( 'red', 'green', 'blue' ) ]
+                        setKernelValue( node, 'Show Cost', False )
+
+                        result = ( variant, width, height, noise_range, size, rotate, width * height / 1e6 / max( seconds, 1e-6 ) ) + tuple( cost )
+                        print( '%-10s %5dx%-5d range %g size %g rotate %g : %.2f MP/s, %.1f hashed, %.1f searched, %.1f points' % result )
+                        results.append( result )
+    finally:
+        restoreSettings( settings )
+    return results
+
+
+def goldenPath( folder, variant ):
+    '''
+    Return the file path of the golden image of a noise variant
+    '''
+    return os.path.join( folder, 'cellnoise_golden_%s.exr' % variant.lower() )
+
+
+def writeGolden( node, path, frame=None ):
+    '''
+    Render a node to an exr to compare later renders against
+    '''
+    frame = nuke.frame() if frame is None else frame
+    renderTime( node, path, frame )
+
+
+def largestDifference( node, golden, frame ):
+    '''
+    Return the largest difference between two nodes over every pixel of each rgba channel
+    '''
+    difference = nuke.nodes.Merge2( operation='difference', inputs=[ golden, node ] )
+    inv = nuke.nodes.Invert( channels='rgba', inputs=[ difference ] )
+    largest = 0.0
+    try:
+        for channel in ( 'red', 'green', 'blue', 'alpha' ):
+            # The smallest inverted difference is one minus the largest
+            maxColor = nuke.nodes.MinColor( channels='rgba.%s' % channel, target=0, inputs=[ inv ] )
+            nuke.execute( maxColor, frame, frame )
+            largest = max( largest, maxColor['pixeldelta'].value() + 1 )
+            nuke.delete( maxColor )
+    finally:
+        for n in ( inv, difference ):
+            nuke.delete( n )
+    return largest
+
+
+def compareGolden( node, path, tolerance=1e-5, frame=None ):
+    '''
+    Compare every pixel of a node against a golden image in every rgba channel.
+    Returns ( passed, largest difference )
+    '''
+    frame = nuke.frame() if frame is None else frame
+    golden = nuke.nodes.Read( file=path )
+    try:
+        difference = largestDifference( node, golden, frame )
+    finally:
+        nuke.delete( golden )
+    return difference <= tolerance, difference
+
+
+def writeGoldens( node, folder, frame=None ):
+    '''
+    Record a golden image of every noise variant with the node's current format, transform and other settings.
+    Record them from a known good kernel before changing it, then check the change with compareGoldens()
+    '''
+    frame = nuke.frame() if frame is None else frame
+    if not os.path.isdir( folder ):
+        os.makedirs( folder )
+    settings = saveSettings( node )
+    try:
+        for variant, metric, mode in NOISE_VARIANTS:
+            setKernelValue( node, 'Metric', metric )
+            setKernelValue( node, 'Mode', mode )
+            writeGolden( node, goldenPath( folder, variant ), frame )
+    finally:
+        restoreSettings( settings )
+
+
+def compareGoldens( node, folder, tolerance=1e-5, frame=None ):
+    '''
+    Compare every noise variant against the golden images from writeGoldens(), with the node set up as it was then.
+    Prints and returns ( variant, passed, largest difference ) for each
+    '''
+    frame = nuke.frame() if frame is None else frame
+    settings = saveSettings( node )
+    results = []
+    try:
+        for variant, metric, mode in NOISE_VARIANTS:
+            path = goldenPath( folder, variant )
+            if not os.path.exists( path ):
+                raise IOError( 'No golden image for %s at %s, record them with writeGoldens() first' % ( variant, path ) )
+            setKernelValue( node, 'Metric', metric )
+            setKernelValue( node, 'Mode', mode )
+            passed, difference = compareGolden( node, path, tolerance, frame )
+            print( '%-10s %s, largest difference %g' % ( variant, 'passed' if passed else 'FAILED', difference ) )
+            results.append( ( variant, passed, difference ) )
+    finally:
+        restoreSettings( settings )
+    return results
\ No newline at end of file
@@ -0,0 +1 @@
+import CellNoise
\ No newline at end of file
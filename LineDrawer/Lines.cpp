@@ -1,9 +1,12 @@
 // Max number of points hard coded. Must be this number of points declared in param, and added to points[] in init()
+// For longer paths set Data Points and connect a LinesPath output to path and its LinesGrid output to grid
 # define upper_limit 16
 
 kernel Lines : ImageComputationKernel<ePixelWise>
 {
   
+  Image<eRead, eAccessRandom> path;
+  Image<eRead, eAccessRandom> grid;
   Image<eWrite> dst;
 
 
@@ -19,6 +22,8 @@ kernel Lines : ImageComputationKernel<ePixelWise>
     float spacing;
     float offset;
     float anim_time;
+    int data_points;
+    int cell_size;
     float2 start;
 
     // # of points = upper_limit
@@ -46,6 +51,8 @@ kernel Lines : ImageComputationKernel<ePixelWise>
     int line_limit;
     float max_length;
     float animated_end;
+    int data_width;
+    int4 box;
 
 
   void define() {
@@ -60,6 +67,8 @@ kernel Lines : ImageComputationKernel<ePixelWise>
     defineParam( spacing,    "Spacing",     30.0f );
     defineParam( offset,     "Dash Offset", 0.0f );
     defineParam( anim_time,  "Time",        1.0f );
+    defineParam( data_points, "Data Points", 0 );
+    defineParam( cell_size,  "Cell Size",   64 );
     defineParam( start,      "Start",       float2( 100.0f, 100.0f ) );
     defineParam( pt1,        "pt1",         float2( 540.0f, 100.0f ) );
     defineParam( pt2,        "pt2",         float2( 540.0f, 380.0f ) );
@@ -67,6 +76,19 @@ kernel Lines : ImageComputationKernel<ePixelWise>
   }
 
 
+  // --- Line Projection ---
+  // Projection components for the segment p0 to p1 [ direction x, direction y, inverse squared length, length ].
+  // A zero length segment projects everything onto p0
+  float4 lineProjection( float2 p0, float2 p1 ) {
+
+    float2 direction = p1 - p0;
+    float length_sq = dot( direction, direction );
+    float inv_length_sq = length_sq > 0.0f ? 1.0f / length_sq : 0.0f;
+
+    return float4( direction.x, direction.y, inv_length_sq, sqrt( length_sq ) );
+  }
+
+
   void init() {
 
     // # of points = upper_limit
@@ -87,45 +109,52 @@ kernel Lines : ImageComputationKernel<ePixelWise>
     points[14] = pt14;
     points[15] = pt15;
 
-    // Keep used points within upper limit
-    pt_limit = min( max_pts, upper_limit );
+    // Keep used points within upper limit, unless reading points from the path input
+    pt_limit = data_points > 0 ? data_points : min( max_pts, upper_limit );
     line_limit = close ? pt_limit : pt_limit - 1;
+    data_width = path.bounds.width();
 
     max_length = 0.0f;
 
-    // Calculate line equation components for each line
-    // [ slope, y_intercept, slope_perp, horizontal/vertical, cumulative distance ]
-    for ( int i = 0; i < line_limit; i++ ) {
+    // Calculate projection components for each line
+    // [ direction x, direction y, inverse squared length, length, cumulative distance ]
+    for ( int i = 0; i < ( data_points > 0 ? 0 : line_limit ); i++ ) {
 
       int next = ( i + 1 ) % pt_limit;
-      float2 direction = points[next] - points[i];
-
-      if ( direction.y == 0 ) {
-        // Horizontal
-        lines[i][3] = 1.0f;
-      } else if ( direction.x == 0 ) {
-        // Vertical
-        lines[i][3] = 2.0f;
-      } else {
-        // Slope
-        lines[i][0] = direction.y / direction.x;
-        // Y Intercept
-        lines[i][1] = points[next].y - lines[i][0] * points[next].x;
-        // Slope Perp
-        lines[i][2] = -( 1 / lines[i][0] );
-        // Not Horizontal or Vertical
-        lines[i][3] = 0.0f;
-      }
+      float4 line = lineProjection( points[i], points[next] );
 
-      float line_length = length( points[next] - points[i] );
-      max_length += line_length;
+      lines[i][0] = line.x;
+      lines[i][1] = line.y;
+      lines[i][2] = line.z;
+      lines[i][3] = line.w;
+
+      max_length += line.w;
       lines[i][4] = max_length;
     }
 
     
     // --- Animation ---
 
+    // Path data holds its total length after its last point, so its end is found in process
     animated_end = clamp( anim_time, 0.0f, 1.0f ) * max_length;
+
+
+    // --- Bounding Box ---
+
+    // Every point, dilated by the width and softness, straight ends reaching one softness further along the line.
+    // Path data is limited by its grid instead
+    if ( data_points > 0 ) {
+      box = int4( dst.bounds.x1, dst.bounds.y1, dst.bounds.x2, dst.bounds.y2 );
+    } else {
+      float2 low = points[0];
+      float2 high = points[0];
+      for ( int i = 1; i < pt_limit; i++ ) {
+        low = min( low, points[i] );
+        high = max( high, points[i] );
+      }
+      float reach = width + softness + ( round_ends ? 0.0f : softness ) + 1.0f;
+      box = int4( floor( low.x - reach ), floor( low.y - reach ), ceil( high.x + reach ), ceil( high.y + reach ) );
+    }
   }
 
 
@@ -145,105 +174,135 @@ kernel Lines : ImageComputationKernel<ePixelWise>
 
 
 
-  void process( int2 pos ) {
+  // --- Segment Value ---
+  // Value at pos from the segment starting at p0, line being its projection [ direction x, direction y, inverse squared length, length ]
+  // and start_length the distance along the whole path at p0, cut off past animated_to
+  float segmentValue( int2 pos, float2 p0, float4 line, float start_length, bool straight_end, float animated_to ) {
 
-    float result = 0.0f;
-    float2 intersection;
-
-    // Find the current pixel value from each line
-    for ( int i = 0; i < line_limit; i++) {
+    // --- Projection of current point ---
 
-      // --- Intersection from current point ---
-
-      if ( lines[i][3] == 2.0f ) {
-        // Vertical
-        intersection = float2( points[i].x, pos.y );
-      } else if ( lines[i][3] == 1.0f ) {
-        // Horizontal
-        intersection = float2( pos.x, points[i].y );
-      } else {
-        // Intersection @ x using line equations
-        intersection[0] = ( pos.y - lines[i][1] - lines[i][2] * pos.x ) / ( lines[i][0] - lines[i][2] );
-        // Intersection @ y using Line 1 equation
-        intersection[1] = intersection[0] * lines[i][0] + lines[i][1];
-      }
+    float2 direction = float2( line.x, line.y );
+    float2 to_pixel = float2( pos.x - p0.x, pos.y - p0.y );
 
+    // Position along the infinite line, and along the segment itself
+    float along = dot( to_pixel, direction ) * line.z;
+    float t = clamp( along, 0.0f, 1.0f );
 
-      // --- Value for current line ---
+    // Distance to the segment, to the infinite line, and past the nearest end along the line
+    float closest = length( to_pixel - direction * t );
+    float distance = length( to_pixel - direction * along );
+    float past_end = fabs( along - t ) * line.w;
+    bool edge = past_end > 0.0f;
 
-      int next = ( i + 1 ) % pt_limit;
-      float distance = length( float2( pos.x - intersection.x, pos.y - intersection.y ) );
-      float line_result = 0.0f;
-      float distance_along_line = i > 0 ? lines[i-1][4] : 0.0f;
-      bool edge = false;
 
-      // If in bounds
-      if ( intersection.x >= min( points[i].x, points[next].x ) && max( points[i].x, points[next].x ) >= intersection.x &&
-           intersection.y >= min( points[i].y, points[next].y ) && max( points[i].y, points[next].y ) >= intersection.y ) {
+    // --- Value for current line ---
 
-        line_result = distanceToValue( distance );
-        distance_along_line += length( intersection - points[i] );
+    // Round ends fall out of the clamped projection, straight ends fade over one softness past the end
+    float line_result = straight_end ? distanceToValue( past_end + width ) * distanceToValue( distance ) * float( past_end <= softness )
+                                     : distanceToValue( closest );
+    float distance_along_line = start_length + t * line.w;
 
-      } else {
+    // Cutoff Animated Length
+    if ( distance_along_line > animated_to )
+    	line_result = 0.0f;
 
-        edge = true;
 
-        // Calculate closest end point
-        float dist_to_start = length( float2( points[i].x - pos.x, points[i].y - pos.y ) );
-        float dist_to_end = length( float2( points[next].x - pos.x, points[next].y - pos.y ) );
+    // --- Dashed Line ---
 
-        float closest = min( dist_to_start, dist_to_end );
-        distance_along_line = ( closest == dist_to_end ) ? lines[i][4] : distance_along_line;
+    // If dashed
+    if ( dashed && line_result > 0.0f ) {
 
-        // Straight edges
-        if ( !close && !round_ends && ( i == 0 || i == pt_limit - 2 ) ) {
+      // Dash animation
+      float dash_offset = distance_along_line + spacing * offset;
+      // Prevent double line at start if reversed
+      float new_distance = dash_offset < 0 ? fabs( dash_offset - spacing ) : dash_offset;
 
-          float closest_end;
-          if ( dist_to_start < dist_to_end )
-            closest_end = length( intersection - points[i] );
-          else
-            closest_end = length( intersection - points[next] );
+      // On / Off segments
+      float segment = new_distance / spacing;
+      int gap = ( int )segment % 2;
 
-          if ( closest_end <= softness )
-            line_result = distanceToValue( closest_end + width ) * distanceToValue( distance );
-        }
-        // Round ends
-        else {
-          line_result = distanceToValue( closest );
-        }
+      // If an odd numbered segment, fade edges into nothing
+      if ( gap == 1) {
+        float segment_distance = ( segment - floor( segment ) ) * spacing;
+        if ( segment_distance < softness && !edge )
+          line_result = line_result * ( 1 - segment_distance / softness );
+        else if ( spacing - segment_distance < softness && !edge )
+          line_result = line_result * ( 1 - ( spacing - segment_distance ) / softness );
+        else
+          line_result = 0.0f;
       }
+    }
+
+    return line_result;
+  }
+
+
+
+  // --- Path Data ---
+  float4 pathEntry( int i ) {
+    return path( path.bounds.x1 + i % data_width, path.bounds.y1 + i / data_width );
+  }
+
+
+  // Value at pos from segment i of the path input, rg being the point, b the length of the path up to it and a the
+  // segment's inverse squared length. The entry after the last point closes the path, so segment i always ends at entry i + 1
+  float dataSegmentValue( int2 pos, int i, float animated_to ) {
+
+    float4 a = pathEntry( i );
+    float4 b = pathEntry( i + 1 );
+    float4 line = float4( b.x - a.x, b.y - a.y, a.w, b.z - a.z );
+    bool straight_end = !close && !round_ends && ( i == 0 || i == pt_limit - 2 );
 
-      // Cutoff Animated Length
-      if ( distance_along_line > animated_end )
-      	line_result = 0.0f;
+    return segmentValue( pos, float2( a.x, a.y ), line, a.z, straight_end, animated_to );
+  }
 
 
-      // --- Dashed Line ---
 
-      // If dashed
-      if ( dashed && line_result > 0.0f ) {
+  void process( int2 pos ) {
 
-        // Dash animation
-        float dash_offset = distance_along_line + spacing * offset;
-        // Prevent double line at start if reversed
-        float new_distance = dash_offset < 0 ? fabs( dash_offset - spacing ) : dash_offset;
+    float result = 0.0f;
 
-        // On / Off segments
-        float segment = new_distance / spacing;
-        int gap = ( int )segment % 2;
+    // Nothing to draw outside the stroke's bounding box
+    if ( pos.x < box.x || pos.y < box.y || pos.x > box.z || pos.y > box.w ) {
+      dst() = colour * result;
+      return;
+    }
 
-        // If an odd numbered segment, fade edges into nothing
-        if ( gap == 1) {
-          float segment_distance = ( segment - floor( segment ) ) * spacing;
-          if ( segment_distance < softness && !edge )
-            line_result = line_result * ( 1 - segment_distance / softness );
-          else if ( spacing - segment_distance < softness && !edge )
-            line_result = line_result * ( 1 - ( spacing - segment_distance ) / softness );
-          else
-            line_result = 0.0f;
+    // Path data, only the segments bucketed into this pixel's grid cell are evaluated
+    if ( data_points > 0 ) {
+
+      float total_length = pathEntry( data_points ).z;
+      float data_end = clamp( anim_time, 0.0f, 1.0f ) * total_length;
+
+      // Cells are counted from screen 0,0, matching LinesGrid
+      int2 cell = int2( floor( pos.x / float( cell_size ) ), floor( pos.y / float( cell_size ) ) ) + int2( grid.bounds.x1, grid.bounds.y1 );
+      float4 runs = float4( 0.0f, float( line_limit - 1 ), -1.0f, -1.0f );
+      if ( grid.bounds.inside( cell.x, cell.y ) )
+        runs = grid( cell.x, cell.y );
+
+      for ( int run = 0; run < 2; run++ ) {
+        int first = int( run == 0 ? runs.x : runs.z );
+        int last = int( run == 0 ? runs.y : runs.w );
+        for ( int i = max( first, 0 ); i <= last; i++ ) {
+          // Cutoff Animated Length before evaluating the segment at all
+          if ( pathEntry( i ).z > data_end )
+            continue;
+          result = max( dataSegmentValue( pos, i, data_end ), result );
         }
       }
 
+      dst() = colour * result;
+      return;
+    }
+
+    // Find the current pixel value from each line
+    for ( int i = 0; i < line_limit; i++) {
+
+      float4 line = float4( lines[i][0], lines[i][1], lines[i][2], lines[i][3] );
+      float start_length = i > 0 ? lines[i-1][4] : 0.0f;
+      bool straight_end = !close && !round_ends && ( i == 0 || i == pt_limit - 2 );
+      float line_result = segmentValue( pos, points[i], line, start_length, straight_end, animated_end );
+
 
       // --- Use max line value ---
 
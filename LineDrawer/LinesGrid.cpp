@@ -0,0 +1,85 @@
+// Buckets the segments of a LinesPath output into a screen grid for Lines. Use a format of
+// ceil( width / Cell Size ) x ceil( height / Cell Size ), each pixel being one cell, counted from screen 0,0.
+// Each cell holds up to two runs of segment indices whose dilated segments touch it, ( first, last, first, last ) in rgba.
+// An unused run is -1, and a cell touched by more than two runs has its last run extended to cover them
+kernel LinesGrid : ImageComputationKernel<ePixelWise>
+{
+  Image<eRead, eAccessRandom> path;
+  Image<eWrite> dst;
+
+
+  param:
+    int data_points;
+    bool close;
+    bool round_ends;
+    int cell_size;
+    float width;
+    float softness;
+
+
+  local:
+    int data_width;
+    int segments;
+    float reach;
+
+
+  void define() {
+    defineParam( data_points, "Data Points", 0 );
+    defineParam( close,       "Close end",   false );
+    defineParam( round_ends,  "Round ends",  false );
+    defineParam( cell_size,   "Cell Size",   64 );
+    defineParam( width,       "Width",       5.0f );
+    defineParam( softness,    "Softness",    1.0f );
+  }
+
+
+  void init() {
+    data_width = path.bounds.width();
+    segments = close ? data_points : data_points - 1;
+
+    // Half the cell's diagonal plus the stroke, anything further from the cell centre can't touch it.
+    // Straight ends fade one softness past the end point, sqrt( softness^2 + ( width + softness )^2 ) at most
+    reach = 0.7072f * cell_size + width + softness + ( close || round_ends ? 0.0f : softness );
+  }
+
+
+  float2 dataPoint( int i ) {
+    float4 value = path( path.bounds.x1 + i % data_width, path.bounds.y1 + i / data_width );
+    return float2( value.x, value.y );
+  }
+
+
+  // Distance from a point to a segment
+  float segmentDistance( float2 p, float2 p0, float2 p1 ) {
+    float2 direction = p1 - p0;
+    float length_sq = dot( direction, direction );
+    float t = length_sq > 0.0f ? clamp( dot( p - p0, direction ) / length_sq, 0.0f, 1.0f ) : 0.0f;
+    return length( p - ( p0 + direction * t ) );
+  }
+
+
+  void process( int2 pos ) {
+
+    float2 centre = float2( ( pos.x - dst.bounds.x1 + 0.5f ) * cell_size, ( pos.y - dst.bounds.y1 + 0.5f ) * cell_size );
+    float4 runs = float4( -1.0f, -1.0f, -1.0f, -1.0f );
+
+    for ( int i = 0; i < segments; i++ ) {
+
+      if ( segmentDistance( centre, dataPoint( i ), dataPoint( ( i + 1 ) % data_points ) ) > reach )
+        continue;
+
+      // Extend the current run, start the second run, or stretch the second run over the gap
+      if ( runs.x < 0.0f )
+        runs = float4( float( i ), float( i ), -1.0f, -1.0f );
+      else if ( runs.z < 0.0f && runs.y == i - 1 )
+        runs.y = float( i );
+      else if ( runs.z < 0.0f )
+        runs = float4( runs.x, runs.y, float( i ), float( i ) );
+      else
+        runs.w = float( i );
+    }
+
+    dst() = runs;
+  }
+
+};
\ No newline at end of file
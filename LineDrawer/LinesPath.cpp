@@ -0,0 +1,61 @@
+// Prepares point data for Lines. Point i is read from pixel ( i % width, i / width ) of the points input, xy in rg.
+// Outputs the same layout with the point in rg, the path length up to the point in b and the inverse squared length of the
+// segment leaving it in a, so Lines never divides per pixel. One more entry after the last point repeats the first point
+// with the total path length in b, closing the path. Use a format holding at least Data Points + 1 pixels
+kernel LinesPath : ImageComputationKernel<ePixelWise>
+{
+  Image<eRead, eAccessRandom> points;
+  Image<eWrite> dst;
+
+
+  param:
+    int data_points;
+    bool close;
+
+
+  local:
+    int data_width;
+    int segments;
+
+
+  void define() {
+    defineParam( data_points, "Data Points", 0 );
+    defineParam( close,       "Close end",   false );
+  }
+
+
+  void init() {
+    data_width = points.bounds.width();
+    segments = close ? data_points : data_points - 1;
+  }
+
+
+  float2 dataPoint( int i ) {
+    float4 value = points( points.bounds.x1 + i % data_width, points.bounds.y1 + i / data_width );
+    return float2( value.x, value.y );
+  }
+
+
+  void process( int2 pos ) {
+
+    int index = ( pos.y - dst.bounds.y1 ) * data_width + pos.x - dst.bounds.x1;
+    if ( index > data_points || data_points == 0 ) {
+      dst() = float4( 0.0f, 0.0f, 0.0f, 0.0f );
+      return;
+    }
+
+    // Length of every segment before this point
+    float cumulative = 0.0f;
+    for ( int i = 0; i < min( index, segments ); i++ )
+      cumulative += length( dataPoint( ( i + 1 ) % data_points ) - dataPoint( i ) );
+
+    // Inverse squared length of the segment leaving this point, 0 for a zero length segment or the end of the path
+    float2 point = dataPoint( index % data_points );
+    float2 direction = dataPoint( ( index + 1 ) % data_points ) - point;
+    float length_sq = dot( direction, direction );
+    float inv_length_sq = index < segments && length_sq > 0.0f ? 1.0f / length_sq : 0.0f;
+
+    dst() = float4( point.x, point.y, cumulative, inv_length_sq );
+  }
+
+};
\ No newline at end of file
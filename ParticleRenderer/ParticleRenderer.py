@@ -1,5 +1,33 @@
 import nuke
+import json
 import os
+import re
+import shutil
+import subprocess
+import tempfile
+import threading
+import time
+
+
+# Counters written by the Stats_V01_01 kernel, in output pixel order
+RENDER_STATS = ( 'read', 'culled_frustum', 'culled_zclip', 'culled_depth_mask', 'drawn',
+                 'pixels_touched', 'safety_clamps', 'average_overdraw' )
+
+# Exr compression written by each particle export codec. raw caches the particle system itself through a ParticleCache
+EXPORT_CODECS = {
+    'none': 'none',
+    'zip':  'Zip (1 scanline)',
+    'piz':  'PIZ Wavelet (32 scanlines)',
+    'dwaa': 'DWAA',
+    'raw':  None,
+}
+
+# Run by each export worker through nuke -t, with the script copy, export node, output path, codec, frame range and
+# results path as arguments
+EXPORT_WORKER = '''import sys
+import ParticleRenderer
+ParticleRenderer.exportWorker( sys.argv[1], sys.argv[2], sys.argv[3], sys.argv[4], int( sys.argv[5] ), int( sys.argv[6] ), sys.argv[7] )
+'''
 
 
 def particleWrite():
@@ -10,6 +38,222 @@ def particleWrite():
     write['Render'].execute()
 
 
+def particleExport():
+    '''
+    Renders the ParticleWrite frame range using the codec and number of workers set on the node
+    '''
+    node = nuke.thisNode()
+    codec = node['codec'].value()
+    path, ext = os.path.splitext( node['write'].value() )
+    if '#' not in path and '%' not in path:
+        path += '.####'
+    path += '.nkpc' if codec == 'raw' else '.exr'
+    export = nuke.toNode( 'ParticleCache1' if codec == 'raw' else 'Write1' )
+    exportFrames( export, path, int( node['first'].value() ), int( node['last'].value() ),
+                  codec=codec, workers=int( node['workers'].value() ) )
+
+
+def frameChunks( first, last, workers ):
+    '''
+    Split an inclusive frame range into one contiguous ( first, last ) range per worker
+    '''
+    count = last - first + 1
+    workers = max( 1, min( workers, count ) )
+    size, extra = divmod( count, workers )
+    chunks = []
+    start = first
+    for i in range( workers ):
+        end = start + size - 1 + ( 1 if i < extra else 0 )
+        chunks.append( ( start, end ) )
+        start = end + 1
+    return chunks
+
+
+def framePath( path, frame ):
+    '''
+    Return the file path for a frame of a #### or %04d style path
+    '''
+    path = re.sub( r'#+', lambda match: '%%0%dd' % len( match.group() ), path )
+    return path % frame if '%' in path else path
+
+
+def configureExport( node, path, codec ):
+    '''
+    Set a Write node to output a 32 bit exr with the given export codec, or a ParticleCache to cache to path for raw
+    '''
+    node['file'].setValue( path )
+    if codec == 'raw':
+        return
+    node['file_type'].setValue( 'exr' )
+    node['datatype'].setValue( '32 bit float' )
+    node['compression'].setValue( EXPORT_CODECS[ codec ] )
+
+
+def saveScriptCopy( path ):
+    '''
+    Save the current script to another file, leaving the open script's name and modified state as they were
+    '''
+    if hasattr( nuke, 'scriptSaveToTemp' ):
+        nuke.scriptSaveToTemp( path )
+        return
+    name = nuke.root().name()
+    modified = nuke.modified()
+    nuke.scriptSaveAs( path, overwrite=1 )
+    nuke.root()['name'].setValue( name )
+    nuke.modified( modified )
+
+
+def dropFileCache( path ):
+    '''
+    Ask the OS to drop a file from its page cache so the next read comes from disk
+    Returns False where posix_fadvise is unavailable and the read may be served from memory
+    '''
+    if not hasattr( os, 'posix_fadvise' ):
+        return False
+    fd = os.open( path, os.O_RDONLY )
+    try:
+        os.fsync( fd )
+        os.posix_fadvise( fd, 0, 0, os.POSIX_FADV_DONTNEED )
+    finally:
+        os.close( fd )
+    return True
+
+
+def decodeTime( path, frame, codec ):
+    '''
+    Return the seconds taken to read and decode every pixel of an exr through a Read node, and whether the file was
+    dropped from the page cache first. A raw particle cache is read back through a ParticleCache and ParticleToImage
+    '''
+    cold = dropFileCache( path )
+    if hasattr( nuke, 'clearRAMCache' ):
+        nuke.clearRAMCache()
+    if codec == 'raw':
+        read = nuke.nodes.ParticleCache( file=path, read_from_file=True )
+        image = nuke.nodes.ParticleToImage( inputs=[ read ] )
+    else:
+        read = nuke.nodes.Read( file=path, first=frame, last=frame )
+        image = read
+    # Averaging the intensities pulls every pixel of the format through the Read
+    curve = nuke.nodes.CurveTool( operation='Avg Intensities', inputs=[ image ] )
+    try:
+        start = time.time()
+        nuke.execute( curve, frame, frame )
+        return time.time() - start, cold
+    finally:
+        nuke.delete( curve )
+        if image is not read:
+            nuke.delete( image )
+        nuke.delete( read )
+
+
+def exportWorker( script, node_name, path, codec, first, last, results_path ):
+    '''
+    Render a frame range one frame at a time inside a terminal nuke process, then time decoding each written file
+    The export node is set up in the worker's copy of the script, so the user's own node keeps its settings.
+    Writes a json list of [ frame, write seconds, read seconds, bytes, cold read ] to results_path. Timing starts
+    after the script is loaded, so nuke startup is not counted against any frame
+    '''
+    nuke.scriptOpen( script )
+    node = nuke.toNode( node_name )
+    configureExport( node, path, codec )
+    results = []
+    for frame in range( first, last + 1 ):
+        start = time.time()
+        nuke.execute( node, frame, frame )
+        write_time = time.time() - start
+        results.append( [ frame, write_time ] )
+
+    # Decode after the whole part is written, so each read is not following straight on from its own write
+    for result in results:
+        frame_path = framePath( path, result[0] )
+        read_time, cold = decodeTime( frame_path, result[0], codec )
+        result += [ read_time, os.path.getsize( frame_path ), cold ]
+    with open( results_path, 'w' ) as f:
+        json.dump( results, f )
+
+
+def exportFrames( node, path, first, last, codec='zip', workers=4, call=subprocess.call ):
+    '''
+    Render a frame range of a particle cache using several terminal nuke processes at once
+    Prints the write and read time of each frame and returns them as a list of
+    ( frame, write seconds, read seconds, bytes ) tuples. Write time is the frame's own render and write, read time
+    decodes the whole file, from disk where the OS cache can be dropped
+    args:
+       node     - Write node to render, or a ParticleCache for raw. The workers render a saved copy of the script and
+                  set the node up there, so the open script and its node are untouched
+       path     - output file path with #### or %04d frame padding
+       first    - first frame to render
+       last     - last frame to render
+       codec    - key of EXPORT_CODECS
+       workers  - number of render processes, each one renders a contiguous part of the range
+       call     - runs a command line and returns its exit code
+    '''
+    if codec not in EXPORT_CODECS:
+        raise ValueError( 'Unknown export codec %s, expected one of %s' % ( codec, ', '.join( sorted( EXPORT_CODECS ) ) ) )
+    folder = tempfile.mkdtemp( prefix='ParticleExport_' )
+    script = os.path.join( folder, 'export.nk' )
+    worker = os.path.join( folder, 'worker.py' )
+    saveScriptCopy( script )
+    with open( worker, 'w' ) as f:
+        f.write( EXPORT_WORKER )
+
+    codes = {}
+    def render( chunk ):
+        results_path = os.path.join( folder, '%d-%d.json' % chunk )
+        command = [ nuke.EXE_PATH, '-t', worker, script, node.fullName(), path, codec, str( chunk[0] ), str( chunk[1] ), results_path ]
+        codes[ chunk ] = call( command )
+
+    try:
+        threads = [ threading.Thread( target=render, args=( chunk, ) ) for chunk in frameChunks( first, last, workers ) ]
+        for thread in threads:
+            thread.start()
+        for thread in threads:
+            thread.join()
+
+        results = []
+        for chunk in sorted( codes ):
+            if codes[ chunk ] != 0:
+                raise RuntimeError( 'Frames %d-%d failed to render ( exit code %d )' % ( chunk[0], chunk[1], codes[ chunk ] ) )
+            with open( os.path.join( folder, '%d-%d.json' % chunk ) ) as f:
+                for frame, write_time, read_time, size, cold in json.load( f ):
+                    print( '%s frame %d : write %.3fs, read %.3fs%s, %d bytes' %
+                           ( codec, frame, write_time, read_time, '' if cold else ' ( cached )', size ) )
+                    results.append( ( frame, write_time, read_time, size ) )
+        return results
+    finally:
+        shutil.rmtree( folder, ignore_errors=True )
+
+
+def getRenderStats( statsNode, frame=None ):
+    '''
+    Return the render statistics of a Stats_V01_01 BlinkScript node at a frame as a dict
+    args:
+       statsNode  - BlinkScript node running the stats kernel with an 8x1 format
+       frame      - frame to sample, defaults to the current frame
+    '''
+    frame = nuke.frame() if frame is None else frame
+    stats = {}
+    for index, name in enumerate( RENDER_STATS ):
+        if name == 'average_overdraw':
+            stats[ name ] = statsNode.sample( 'rgba.red', index + 0.5, 0.5, 1, 1, frame )
+            continue
+        # Counts are exact in green and blue, as whole multiples of 2^24 and the remainder
+        high = statsNode.sample( 'rgba.green', index + 0.5, 0.5, 1, 1, frame )
+        low = statsNode.sample( 'rgba.blue', index + 0.5, 0.5, 1, 1, frame )
+        stats[ name ] = int( round( high ) ) * 16777216 + int( round( low ) )
+    return stats
+
+
+def writeRenderStats( statsNode, path, first, last ):
+    '''
+    Write the render statistics for a frame range to a sidecar json file, keyed by frame
+    '''
+    stats = dict( ( str( frame ), getRenderStats( statsNode, frame ) ) for frame in range( first, last + 1 ) )
+    with open( path, 'w' ) as f:
+        json.dump( stats, f, indent=2, sort_keys=True )
+    return stats
+
+
 def getInput( node, input, ignoreMe='Dot' ):
     """return node's input but ignore the given node class"""
     found = False
@@ -28,6 +28,7 @@ kernel SinglePixel_V01_01 : ImageComputationKernel<ePixelWise>
 
   local:
     float4x4 worldToCamM;
+    float4x4 particleToCamM;
     float4x4 perspM;
 
 
@@ -49,6 +50,17 @@ kernel SinglePixel_V01_01 : ImageComputationKernel<ePixelWise>
   }
 
 
+  // Multiplies two 4x4 matrices, the result applies B then A
+  float4x4 multMatrix( float4x4 A, float4x4 B ) {
+    float4x4 out;
+    for ( int row = 0; row < 4; row++ ) {
+      for ( int col = 0; col < 4; col++ )
+        out[ row ][ col ] = A[ row ][ 0 ] * B[ 0 ][ col ] + A[ row ][ 1 ] * B[ 1 ][ col ] + A[ row ][ 2 ] * B[ 2 ][ col ] + A[ row ][ 3 ] * B[ 3 ][ col ];
+    }
+    return out;
+  }
+
+
   void define() {
     defineParam( use_zclip,         "Use Depth Clipping",     true );
     defineParam( use_depth,         "Use Depth Mask",         false );
@@ -81,6 +93,8 @@ kernel SinglePixel_V01_01 : ImageComputationKernel<ePixelWise>
 
     // Matrix from world space to camera local space
     worldToCamM = camToWorldM.invert();
+    // Particle transform followed by the camera, so each point needs a single affine transform
+    particleToCamM = multMatrix( worldToCamM, particleTransform );
 
     // Output image aspect
     float aspect = width / float( height );
@@ -118,9 +132,8 @@ kernel SinglePixel_V01_01 : ImageComputationKernel<ePixelWise>
     if ( particle.w == 0.0f )
       return;
 
-    // Transform the particle to desired location, then to camera local space
-    float4 particleSpace = multVectMatrix( particle, particleTransform );
-    float4 point_local = multVectMatrix( particleSpace, worldToCamM );
+    // Transform the particle to desired location and camera local space in one
+    float4 point_local = multVectMatrix( particle, particleToCamM );
 
     // Check if position is in front of camera
     if ( point_local.z > 0.0f )
@@ -176,8 +189,7 @@ kernel SinglePixel_V01_01 : ImageComputationKernel<ePixelWise>
       dir = normalize(dir) * length(vel);
 
       // Move new end position to screen space
-      particleSpace = multVectMatrix( particle + dir, particleTransform );
-      point_local = multVectMatrix( particleSpace, worldToCamM );
+      point_local = multVectMatrix( particle + dir, particleToCamM );
       screen_center = multVectMatrix( point_local, perspM );
 
       // Calculate screen velocity
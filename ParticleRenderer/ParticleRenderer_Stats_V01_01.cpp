@@ -0,0 +1,335 @@
+// Render statistics, one counter per output pixel along the bottom row. Use an 8x1 format
+# define STAT_READ 0
+# define STAT_FRUSTUM 1
+# define STAT_ZCLIP 2
+# define STAT_DEPTH_MASK 3
+# define STAT_DRAWN 4
+# define STAT_PIXELS 5
+# define STAT_SAFETY 6
+# define STAT_OVERDRAW 7
+# define STAT_COUNT 8
+
+// Counts are summed as whole multiples of STAT_SPLIT and a remainder, so they stay exact past float precision
+# define STAT_SPLIT 16777216
+
+// Sprite shapes and disc samples, matching ZBuffer
+# define SHAPE_BOX 0
+# define SHAPE_GAUSSIAN 1
+# define SHAPE_DISC 2
+# define SHAPE_COSINE 3
+# define DISC_SAMPLES 4
+
+kernel Stats_V01_01 : ImageComputationKernel<ePixelWise>
+{
+  Image<eRead, eAccessRandom> prebuffer;
+  Image<eRead, eAccessRandom> particles;
+  Image<eRead, eAccessRandom> active;
+  Image<eRead, eAccessRandom> particle_colour;
+  Image<eRead, eAccessRandom, eEdgeClamped> filterImage;
+  Image<eRead, eAccessRandom> depth;
+  Image<eWrite> dst;
+
+
+  param:
+    bool use_filter;
+    bool use_atlas;
+    bool use_pcolour;
+    bool use_zclip;
+    bool use_depth;
+    bool use_psize;
+    bool use_dof;
+    bool safety;
+    int reduce;
+    int sprite_shape;
+    int atlas_columns;
+    int atlas_rows;
+    int safety_limit;
+    int width;
+    int height;
+    float overscan;
+    float depth_max;
+    float size;
+    float fstop;
+    float focus_distance;
+    float world_scale;
+    float haperture;
+    float focal;
+    float znear;
+    float zfar;
+    float4x4 camToWorldM;
+    float4x4 particleTransform;
+
+
+  local:
+    float4x4 worldToCamM;
+    float4x4 particleToCamM;
+    float4x4 perspM;
+    float filterAspectWidth;
+    float filterAspectHeight;
+    float apertureRadius;
+
+
+  // Multiplies a vector 4 by a 4x4 matrix (COLUMN ORDER) (Affine and homogenous)
+  float4 multVectMatrix( float4 vec, float4x4 M ) {
+    float4 out;
+    out[0]  = vec.x * M[0][0] + vec.y * M[0][1] + vec.z * M[0][2] + M[0][3];
+    out[1]  = vec.x * M[1][0] + vec.y * M[1][1] + vec.z * M[1][2] + M[1][3];
+    out[2]  = vec.x * M[2][0] + vec.y * M[2][1] + vec.z * M[2][2] + M[2][3];
+    float w = vec.x * M[3][0] + vec.y * M[3][1] + vec.z * M[3][2] + M[3][3];
+
+    if (w != 1.0f) {
+        out.x /= w;
+        out.y /= w;
+        out.z /= w;
+    }
+
+    return out;
+  }
+
+
+  // Multiplies two 4x4 matrices, the result applies B then A
+  float4x4 multMatrix( float4x4 A, float4x4 B ) {
+    float4x4 out;
+    for ( int row = 0; row < 4; row++ ) {
+      for ( int col = 0; col < 4; col++ )
+        out[ row ][ col ] = A[ row ][ 0 ] * B[ 0 ][ col ] + A[ row ][ 1 ] * B[ 1 ][ col ] + A[ row ][ 2 ] * B[ 2 ][ col ] + A[ row ][ 3 ] * B[ 3 ][ col ];
+    }
+    return out;
+  }
+
+
+  // Whether a Gaussian or Cosine sprite covers any of the pixel starting at p on one axis.
+  // Their profiles are only 0 from the edge onwards, so ZBuffer's coverage is above 0 wherever the pixel overlaps the sprite
+  bool shapeSpans( float p, float mid, float invHalf ) {
+    float s = ( p - mid ) * invHalf;
+    return s < 1.0f && s + invHalf > -1.0f;
+  }
+
+
+  // Smallest squared normalised offset of ZBuffer's disc samples in the pixel starting at p on one axis.
+  // A pixel is covered when the x and y offsets add up to less than 1
+  float discNearest( float p, float mid, float invHalf ) {
+    float nearest = 1e30f;
+    for ( int i = 0; i < DISC_SAMPLES; i++ ) {
+      float offset = ( p + ( i + 0.5f ) * ( 1.0f / DISC_SAMPLES ) - mid ) * invHalf;
+      nearest = min( nearest, offset * offset );
+    }
+    return nearest;
+  }
+
+
+  void define() {
+    defineParam( use_filter,        "Use Filter Image",       false );
+    defineParam( use_atlas,         "Use Sprite Atlas",       false );
+    defineParam( use_pcolour,       "Use Particle Colour",    false );
+    defineParam( use_zclip,         "Use Depth Clipping",     true );
+    defineParam( use_depth,         "Use Depth Mask",         false );
+    defineParam( use_psize,         "Use Particle Size",      false );
+    defineParam( use_dof,           "Use Depth of Field",     false );
+    defineParam( safety,            "Safety",                 true );
+    defineParam( reduce,            "Reduction",              1 );
+    defineParam( sprite_shape,      "Sprite Shape",           SHAPE_BOX );
+    defineParam( atlas_columns,     "Atlas Columns",          1 );
+    defineParam( atlas_rows,        "Atlas Rows",             1 );
+    defineParam( safety_limit,      "Safety Limit",           150 );
+    defineParam( width,             "Width",                  1440 );
+    defineParam( height,            "Height",                 810 );
+    defineParam( overscan,          "Overscan",               0.0f );
+    defineParam( depth_max,         "Depth Range",            1000.0f );
+    defineParam( size,              "Particle Size",          5.0f );
+    defineParam( fstop,             "F-Stop",                 16.0f );
+    defineParam( focus_distance,    "Focus Distance",         100.0f );
+    defineParam( world_scale,       "World Scale",            0.1f );
+    defineParam( haperture,         "Horizontal Aperture",    24.576f );
+    defineParam( focal,             "Focal Length",           50.0f );
+    defineParam( znear,             "Near Clipping",          0.1f );
+    defineParam( zfar,              "Far Clipping",           10000.0f );
+    defineParam( camToWorldM,       "Camera Matrix",          float4x4(
+             1.0f,0.0f,0.0f,0.0f,
+             0.0f,1.0f,0.0f,0.0f,
+             0.0f,0.0f,1.0f,0.0f,
+             0.0f,0.0f,0.0f,1.0f
+             ));
+    defineParam( particleTransform, "Particle Matrix",        float4x4(
+             1.0f,0.0f,0.0f,0.0f,
+             0.0f,1.0f,0.0f,0.0f,
+             0.0f,0.0f,1.0f,0.0f,
+             0.0f,0.0f,0.0f,1.0f
+             ));
+  }
+
+
+  void init() {
+
+    // Matrix from world space to camera local space
+    worldToCamM = camToWorldM.invert();
+    // Particle transform followed by the camera, so each point needs a single affine transform
+    particleToCamM = multMatrix( worldToCamM, particleTransform );
+
+    // Sprite aspect, from a single atlas cell when using an atlas
+    float cellWidth  = filterImage.bounds.width() / float( use_atlas ? max( atlas_columns, 1 ) : 1 );
+    float cellHeight = filterImage.bounds.height() / float( use_atlas ? max( atlas_rows, 1 ) : 1 );
+    filterAspectWidth  = use_filter ? min( cellWidth / cellHeight, 1.0f ) : 1.0f;
+    filterAspectHeight = use_filter ? min( cellHeight / cellWidth, 1.0f ) : 1.0f;
+
+    // Lens aperture radius in world units ( focal length is mm, World Scale is world units per mm )
+    apertureRadius = 0.5f * ( focal / max( fstop, 0.01f ) ) * world_scale;
+
+    // Output image aspect
+    float aspect = width / float( height );
+
+    // Corner co-ordinates of the viewing frustrum
+    float right = ( 0.5f * haperture / focal) * znear;
+    float left = -right;
+    float top = right / aspect;
+    float bottom = -top;
+
+    // Set the Perspective Matrix ( Fits camera space to screen space)
+    perspM[0][0] = ( 2 * znear ) / ( right - left );
+    perspM[0][2] = ( right + left ) / ( right - left );
+    perspM[1][1] = ( 2 * znear ) / ( top - bottom );
+    perspM[1][2] = ( top + bottom ) / ( top - bottom );
+    perspM[2][2] = - ( ( zfar + znear ) / ( zfar - znear ) );
+    perspM[2][3] = - ( ( 2 * zfar * znear ) / ( zfar - znear ) );
+    perspM[3][2] = -1;
+
+  }
+
+
+  // A particle's contribution to one counter, following the same stages as ZBuffer
+  int particleStat( int stat, int x, int y ) {
+
+    // Ignore pixels that are not active, have 0 alpha or are limited to the nth position
+    float id = ( y * particles.bounds.width() + x );
+    if ( active( x, y, 0 ) != 1.0f || ( use_pcolour && particle_colour( x, y, 3 ) == 0.0f ) || fmod( id, float( reduce ) ) != 0.0f )
+      return 0;
+    if ( stat == STAT_READ )
+      return 1;
+
+    float4 particle = particles( x, y );
+    float4 point_local = multVectMatrix( particle, particleToCamM );
+
+    // Behind the camera
+    if ( point_local.z > 0 )
+      return stat == STAT_FRUSTUM ? 1 : 0;
+
+    float4 screen_center = multVectMatrix( point_local, perspM );
+
+    // Outside of the clipping planes
+    if ( use_zclip && ( screen_center.z < -1.0f || 1.0f < screen_center.z ) )
+      return stat == STAT_ZCLIP ? 1 : 0;
+
+    // Centered off screen
+    float ct_x = ( screen_center.x + 1 ) * 0.5f * width + overscan;
+    float ct_y = ( screen_center.y + 1 ) * 0.5f * height + overscan;
+    if ( !prebuffer.bounds.inside( ct_x, ct_y ) )
+      return stat == STAT_FRUSTUM ? 1 : 0;
+
+    // Beyond the depth mask
+    float zdepth = 1.0f + point_local.z / depth_max;
+    if ( use_depth && depth_max != 0.0f ) {
+      int depth_x = floor( ( screen_center.x + 1 ) * 0.5f * depth.bounds.width() );
+      int depth_y = floor( ( screen_center.y + 1 ) * 0.5f * depth.bounds.height() );
+      if ( zdepth < depth( depth_x, depth_y, 0 ) )
+        return stat == STAT_DEPTH_MASK ? 1 : 0;
+    }
+
+    if ( stat == STAT_DRAWN )
+      return 1;
+    if ( stat != STAT_PIXELS && stat != STAT_SAFETY && stat != STAT_OVERDRAW )
+      return 0;
+
+    // Sprite footprint in pixels
+    float psize = use_psize ? size * particle.w : size;
+    if ( use_dof )
+      psize += apertureRadius * fabs( -point_local.z - focus_distance ) / max( focus_distance, znear );
+    float half_x = perspM[0][0] * psize * filterAspectWidth / -point_local.z * 0.5f * width;
+    float half_y = perspM[1][1] * psize * filterAspectHeight / -point_local.z * 0.5f * height;
+    if ( sprite_shape != SHAPE_BOX ) {
+      half_x = max( half_x, 0.5f );
+      half_y = max( half_y, 0.5f );
+    }
+
+    int2 start = int2( floor( ct_x - half_x ), floor( ct_y - half_y ) );
+    int2 range = int2( floor( ct_x + half_x ), floor( ct_y + half_y ) ) - start;
+
+    // Limited to the safety limit
+    bool clamped = safety && ( range.x > safety_limit || range.y > safety_limit );
+    if ( stat == STAT_SAFETY )
+      return clamped ? 1 : 0;
+    if ( clamped ) {
+      start += int2( max( 0, ( range.x - safety_limit ) / 2 ), max( 0, ( range.y - safety_limit ) / 2 ) );
+      range = int2( min( safety_limit, range.x ), min( safety_limit, range.y ) );
+    }
+
+    // Pixels touched within the output, only those the sprite shape covers as in ZBuffer
+    int x_first = max( start.x, prebuffer.bounds.x1 );
+    int y_first = max( start.y, prebuffer.bounds.y1 );
+    int x_last  = min( start.x + range.x, prebuffer.bounds.x2 - 1 );
+    int y_last  = min( start.y + range.y, prebuffer.bounds.y2 - 1 );
+    if ( sprite_shape == SHAPE_BOX )
+      return max( x_last - x_first + 1, 0 ) * max( y_last - y_first + 1, 0 );
+
+    float invHalfX = 1.0f / half_x;
+    float invHalfY = 1.0f / half_y;
+    int pixels = 0;
+    if ( sprite_shape == SHAPE_DISC ) {
+      for ( int py = y_first; py <= y_last; py++ ) {
+        float nearest_y = discNearest( py, ct_y, invHalfY );
+        for ( int px = x_first; px <= x_last && nearest_y < 1.0f; px++ )
+          pixels += discNearest( px, ct_x, invHalfX ) + nearest_y < 1.0f ? 1 : 0;
+      }
+      return pixels;
+    }
+
+    int columns = 0;
+    for ( int px = x_first; px <= x_last; px++ )
+      columns += shapeSpans( px, ct_x, invHalfX ) ? 1 : 0;
+    for ( int py = y_first; py <= y_last; py++ )
+      pixels += shapeSpans( py, ct_y, invHalfY ) ? columns : 0;
+    return pixels;
+  }
+
+
+  void process( int2 pos ) {
+
+    // OUTPUT WILL BE, FOR EACH PIXEL ALONG THE BOTTOM ROW :
+    // 0 = Particles read        1 = Culled by frustum     2 = Culled by zclip       3 = Culled by depth mask
+    // 4 = Particles drawn       5 = Pixels touched        6 = Safety clamps         7 = Average overdraw
+
+    int stat = pos.x - dst.bounds.x1;
+    if ( pos.y != dst.bounds.y1 || stat >= STAT_COUNT ) {
+      dst() = 0.0f;
+      return;
+    }
+
+    // Each row is summed in an int, then carried into whole multiples of STAT_SPLIT, so no count ever rounds
+    int high = 0;
+    int low = 0;
+    for ( int y = particles.bounds.y1; y < particles.bounds.y2; y++ ) {
+      int row = 0;
+      for ( int x = particles.bounds.x1; x < particles.bounds.x2; x++ )
+        row += particleStat( stat, x, y );
+      low += row;
+      high += low / STAT_SPLIT;
+      low = low % STAT_SPLIT;
+    }
+    float total = float( high ) * STAT_SPLIT + float( low );
+
+    // Overdraw is the pixels touched over the pixels ZBuffer gave a depth
+    if ( stat == STAT_OVERDRAW ) {
+      int covered = 0;
+      for ( int y = prebuffer.bounds.y1; y < prebuffer.bounds.y2; y++ ) {
+        for ( int x = prebuffer.bounds.x1; x < prebuffer.bounds.x2; x++ )
+          covered += prebuffer( x, y, 3 ) != 0.0f ? 1 : 0;
+      }
+      dst() = covered > 0 ? total / covered : 0.0f;
+      return;
+    }
+
+    // Red is the count as a float, which rounds once it passes 2^24.
+    // Green and blue hold it exactly, as the multiples of STAT_SPLIT and the remainder
+    dst() = float4( total, float( high ), float( low ), 1.0f );
+  }
+
+};
\ No newline at end of file
@@ -1,9 +1,19 @@
+// Built in sprite shapes. Coverage is the shape's 1-D profile averaged over each pixel, read from a table of its running integral.
+// The disc is not separable, so it averages DISC_SAMPLES x DISC_SAMPLES interpolated profile samples instead
+# define SHAPE_BOX 0
+# define SHAPE_GAUSSIAN 1
+# define SHAPE_DISC 2
+# define SHAPE_COSINE 3
+# define SHAPE_TABLE_SIZE 64
+# define DISC_SAMPLES 4
+
 kernel ZBuffer_V01_01 : ImageComputationKernel<ePixelWise>
 {
   Image<eRead> format;
   Image<eRead, eAccessPoint> particles;
   Image<eRead, eAccessPoint> active;
   Image<eRead, eAccessPoint> particle_colour;
+  Image<eRead, eAccessPoint> particle_sprite;
   Image<eRead, eAccessPoint> velocity;
   Image<eRead, eAccessPoint> velocityNext;
   Image<eRead, eAccessRandom, eEdgeClamped> filterImage;
@@ -13,19 +23,27 @@ kernel ZBuffer_V01_01 : ImageComputationKernel<ePixelWise>
 
   param:
     bool use_filter;
+    bool use_atlas;
     bool use_pcolour;
     bool use_zclip;
     bool use_depth;
     bool use_psize;
+    bool use_dof;
     bool safety;
     bool add_velocity;
     int reduce;
+    int sprite_shape;
+    int atlas_columns;
+    int atlas_rows;
     int safety_limit;
     int width;
     int height;
     float overscan;
     float depth_max;
     float size;
+    float fstop;
+    float focus_distance;
+    float world_scale;
     float haperture;
     float focal;
     float znear;
@@ -36,11 +54,20 @@ kernel ZBuffer_V01_01 : ImageComputationKernel<ePixelWise>
 
   local:
     float4x4 worldToCamM;
+    float4x4 particleToCamM;
     float4x4 perspM;
     int filterWidth;
     int filterHeight;
     float filterAspectWidth;
     float filterAspectHeight;
+    float cellWidth;
+    float cellHeight;
+    float cellLimitX;
+    float cellLimitY;
+    int atlasCells;
+    float apertureRadius;
+    float shapeTable[SHAPE_TABLE_SIZE];
+    float shapeArea[SHAPE_TABLE_SIZE];
 
 
   // Multiplies a vector 4 by a 4x4 matrix (COLUMN ORDER) (Affine and homogenous)
@@ -61,21 +88,79 @@ kernel ZBuffer_V01_01 : ImageComputationKernel<ePixelWise>
   }
 
 
+  // Multiplies two 4x4 matrices, the result applies B then A
+  float4x4 multMatrix( float4x4 A, float4x4 B ) {
+    float4x4 out;
+    for ( int row = 0; row < 4; row++ ) {
+      for ( int col = 0; col < 4; col++ )
+        out[ row ][ col ] = A[ row ][ 0 ] * B[ 0 ][ col ] + A[ row ][ 1 ] * B[ 1 ][ col ] + A[ row ][ 2 ] * B[ 2 ][ col ] + A[ row ][ 3 ] * B[ 3 ][ col ];
+    }
+    return out;
+  }
+
+
+  // Shape profile at a normalised offset from the sprite center ( 0 @ center, 1 @ edge ), interpolated between entries
+  // Gaussian and Cosine are separable, the Disc profile is indexed by squared radius and is 0 from 1 onwards
+  float shapeLookup( float t ) {
+    float index = clamp( t, 0.0f, 1.0f ) * ( SHAPE_TABLE_SIZE - 1 );
+    int i = min( int( index ), SHAPE_TABLE_SIZE - 2 );
+    return shapeTable[ i ] + ( shapeTable[ i + 1 ] - shapeTable[ i ] ) * ( index - i );
+  }
+
+
+  // Integral of the profile from the sprite center to a signed normalised offset, constant past the edge
+  float shapeIntegral( float s ) {
+    float index = min( fabs( s ), 1.0f ) * ( SHAPE_TABLE_SIZE - 1 );
+    int i = min( int( index ), SHAPE_TABLE_SIZE - 2 );
+    float area = shapeArea[ i ] + ( shapeArea[ i + 1 ] - shapeArea[ i ] ) * ( index - i );
+    return s < 0.0f ? -area : area;
+  }
+
+
+  // Separable profile averaged over the pixel starting at p, for a sprite centered on mid
+  // Neighbouring pixels share their edges, so a sprite's total brightness doesn't change with sub-pixel movement
+  float shapeCoverage( float p, float mid, float half, float invHalf ) {
+    float s = ( p - mid ) * invHalf;
+    return ( shapeIntegral( s + invHalf ) - shapeIntegral( s ) ) * half;
+  }
+
+
+  // Disc profile averaged over the pixel starting at p, for a sprite centered on mid
+  float discCoverage( float2 p, float2 mid, float2 invHalf ) {
+    float coverage = 0.0f;
+    for ( int sy = 0; sy < DISC_SAMPLES; sy++ ) {
+      for ( int sx = 0; sx < DISC_SAMPLES; sx++ ) {
+        float2 offset = ( p + float2( sx + 0.5f, sy + 0.5f ) * ( 1.0f / DISC_SAMPLES ) - mid ) * invHalf;
+        coverage += shapeLookup( offset.x * offset.x + offset.y * offset.y );
+      }
+    }
+    return coverage * ( 1.0f / ( DISC_SAMPLES * DISC_SAMPLES ) );
+  }
+
+
   void define() {
     defineParam( use_filter,        "Use Filter Image",       false );
+    defineParam( use_atlas,         "Use Sprite Atlas",       false );
     defineParam( use_pcolour,       "Use Particle Colour",    false );
     defineParam( use_zclip,         "Use Depth Clipping",     true );
     defineParam( use_depth,         "Use Depth Mask",         false );
     defineParam( use_psize,         "Use Particle Size",      false );
+    defineParam( use_dof,           "Use Depth of Field",     false );
     defineParam( safety,            "Safety",                 true );
     defineParam( add_velocity,      "Add Velocity",           true );
     defineParam( reduce,            "Reduction",              1 );
+    defineParam( sprite_shape,      "Sprite Shape",           SHAPE_BOX );
+    defineParam( atlas_columns,     "Atlas Columns",          1 );
+    defineParam( atlas_rows,        "Atlas Rows",             1 );
     defineParam( safety_limit,      "Safety Limit",           150 );
     defineParam( width,             "Width",                  1440 );
     defineParam( height,            "Height",                 810 );
     defineParam( overscan,          "Overscan",               0.0f );
     defineParam( depth_max,         "Depth Range",            1000.0f );
     defineParam( size,              "Particle Size",          5.0f );
+    defineParam( fstop,             "F-Stop",                 16.0f );
+    defineParam( focus_distance,    "Focus Distance",         100.0f );
+    defineParam( world_scale,       "World Scale",            0.1f );
     defineParam( haperture,         "Horizontal Aperture",    24.576f );
     defineParam( focal,             "Focal Length",           50.0f );
     defineParam( znear,             "Near Clipping",          0.1f );
@@ -99,12 +184,25 @@ kernel ZBuffer_V01_01 : ImageComputationKernel<ePixelWise>
 
     // Matrix from world space to camera local space
     worldToCamM = camToWorldM.invert();
+    // Particle transform followed by the camera, so each point needs a single affine transform
+    particleToCamM = multMatrix( worldToCamM, particleTransform );
 
     // Filter size
     filterWidth  = filterImage.bounds.width();
     filterHeight = filterImage.bounds.height();
-    filterAspectWidth  = use_filter ? min( filterWidth / float( filterHeight ), 1.0f ) : 1.0f;
-    filterAspectHeight = use_filter ? min( filterHeight / float( filterWidth ), 1.0f ) : 1.0f;
+
+    // Atlas cells are an even grid over the filter image, the aspect is taken from a single cell
+    atlasCells = use_atlas ? max( atlas_columns, 1 ) * max( atlas_rows, 1 ) : 1;
+    cellWidth  = use_atlas ? filterWidth / float( max( atlas_columns, 1 ) ) : float( filterWidth );
+    cellHeight = use_atlas ? filterHeight / float( max( atlas_rows, 1 ) ) : float( filterHeight );
+    // Keep samples inside their own cell so neighbouring sprites don't bleed in
+    cellLimitX = use_atlas ? cellWidth - 1.0f : float( filterWidth );
+    cellLimitY = use_atlas ? cellHeight - 1.0f : float( filterHeight );
+    filterAspectWidth  = use_filter ? min( cellWidth / cellHeight, 1.0f ) : 1.0f;
+    filterAspectHeight = use_filter ? min( cellHeight / cellWidth, 1.0f ) : 1.0f;
+
+    // Lens aperture radius in world units ( focal length is mm, World Scale is world units per mm )
+    apertureRadius = 0.5f * ( focal / max( fstop, 0.01f ) ) * world_scale;
 
     // Output image aspect
     float aspect = width / float( height );
@@ -124,6 +222,26 @@ kernel ZBuffer_V01_01 : ImageComputationKernel<ePixelWise>
     perspM[2][3] = - ( ( 2 * zfar * znear ) / ( zfar - znear ) );
     perspM[3][2] = -1;
 
+    // Sprite shape profile, last entry is always 0 so the sprite fades out at its edge
+    float pi = atan2( 0.0f, -1.0f );
+    float gaussEdge = exp( -4.5f );
+    for ( int i = 0; i < SHAPE_TABLE_SIZE; i++ ) {
+      float t = i / float( SHAPE_TABLE_SIZE - 1 );
+      float value = 1.0f;
+      if ( sprite_shape == SHAPE_GAUSSIAN )
+        value = ( exp( -4.5f * t * t ) - gaussEdge ) / ( 1.0f - gaussEdge ); // Edge at 3 sigma
+      else if ( sprite_shape == SHAPE_COSINE )
+        value = 0.5f * ( 1.0f + cos( pi * t ) );
+      else if ( sprite_shape == SHAPE_DISC )
+        value = clamp( ( 1.0f - sqrt( t ) ) * 16.0f, 0.0f, 1.0f ); // t is the squared radius, soften the outer 1/16th
+      shapeTable[ i ] = value;
+    }
+
+    // Running integral of the profile from the center, one trapezoid per entry
+    shapeArea[ 0 ] = 0.0f;
+    for ( int i = 1; i < SHAPE_TABLE_SIZE; i++ )
+      shapeArea[ i ] = shapeArea[ i - 1 ] + 0.5f * ( shapeTable[ i - 1 ] + shapeTable[ i ] ) / ( SHAPE_TABLE_SIZE - 1 );
+
   }
 
 
@@ -148,9 +266,8 @@ kernel ZBuffer_V01_01 : ImageComputationKernel<ePixelWise>
     if ( !particles.bounds.inside( pos ) || fmod( id, float( reduce ) ) != 0.0f )
       return;
 
-    // Transform the particle to desired location, then to camera local space
-    float4 particleSpace = multVectMatrix( particle, particleTransform );
-    float4 point_local = multVectMatrix( particleSpace, worldToCamM );
+    // Transform the particle to desired location and camera local space in one
+    float4 point_local = multVectMatrix( particle, particleToCamM );
 
     // Check if position is in front of camera
     if ( point_local.z > 0 )
@@ -194,23 +311,41 @@ kernel ZBuffer_V01_01 : ImageComputationKernel<ePixelWise>
     dst( pos.x, pos.y, 0 ) = 1.0f;
 
 
+    // --- Sprite atlas cell ---
+
+    // Cell picked by the particle's sprite channel, counted along rows from the bottom left
+    float2 cell_origin = 0.0f;
+    if ( use_atlas ) {
+      int cell = int( floor( particle_sprite( 0 ) ) ) % atlasCells;
+      if ( cell < 0 )
+        cell += atlasCells;
+      cell_origin = float2( ( cell % max( atlas_columns, 1 ) ) * cellWidth, ( cell / max( atlas_columns, 1 ) ) * cellHeight );
+    }
+
+
     // --- Pixel bounds on screen ---
 
     // Add size to create a quad centered on the particle
-    // Can use just bottom left and top right for a non distorted plane
+    // The corners share the center's depth, so only their offsets need projecting ( perspective w is -z )
     float psize = use_psize ? size * particle.w : size;
-    float4 botleft  = point_local - float4( psize * filterAspectWidth, psize * filterAspectHeight, 0.0f, 0.0f );
-    float4 topright = point_local + float4( psize * filterAspectWidth, psize * filterAspectHeight, 0.0f, 0.0f );
 
-    // Transform position to screen space
-    float4 screen_bl = multVectMatrix( botleft, perspM );
-    float4 screen_tr = multVectMatrix( topright, perspM );
+    // Depth of field : grow the sprite by the circle of confusion at the particle's depth to match MAIN
+    if ( use_dof )
+      psize += apertureRadius * fabs( -point_local.z - focus_distance ) / max( focus_distance, znear );
+    float half_x = perspM[0][0] * psize * filterAspectWidth / -point_local.z * 0.5f * width;
+    float half_y = perspM[1][1] * psize * filterAspectHeight / -point_local.z * 0.5f * height;
+
+    // Shaped sprites are at least a pixel wide, so the footprint below always holds the whole profile
+    if ( sprite_shape != SHAPE_BOX ) {
+      half_x = max( half_x, 0.5f );
+      half_y = max( half_y, 0.5f );
+    }
 
-    // Fit screen space to NDC space ( 0 to 1 range ), multiply to get cornerpoints of particle
-    float bl_x = ( screen_bl.x + 1 ) * 0.5f * width + overscan;
-    float bl_y = ( screen_bl.y + 1 ) * 0.5f * height + overscan;
-    float tr_x = ( screen_tr.x + 1 ) * 0.5f * width + overscan;
-    float tr_y = ( screen_tr.y + 1 ) * 0.5f * height + overscan;
+    // Cornerpoints of particle in pixels
+    float bl_x = ct_x - half_x;
+    float bl_y = ct_y - half_y;
+    float tr_x = ct_x + half_x;
+    float tr_y = ct_y + half_y;
 
 
     // --- Velocity ---
@@ -230,8 +365,7 @@ kernel ZBuffer_V01_01 : ImageComputationKernel<ePixelWise>
       dir = normalize(dir) * length(vel);
 
       // Move new end position to screen space
-      particleSpace = multVectMatrix( particle + dir, particleTransform );
-      point_local = multVectMatrix( particleSpace, worldToCamM );
+      point_local = multVectMatrix( particle + dir, particleToCamM );
       screen_center = multVectMatrix( point_local, perspM );
 
       // Calculate screen velocity
@@ -253,35 +387,63 @@ kernel ZBuffer_V01_01 : ImageComputationKernel<ePixelWise>
       range = int2( min( safety_limit, range.x ), min( safety_limit, range.y ) );
     }
 
-    for ( int x = 0; x <= range.x; x++ ) {
-      for ( int y = 0; y <= range.y; y++ ) {
+    // Inverse half size for the shape tables, only used by the shaped sprites
+    float invHalfX = 1.0f / max( half_x, 0.5f );
+    float invHalfY = 1.0f / max( half_y, 0.5f );
 
-        // Current output pixel
-        int2 out = int2( start.x + x, start.y + y );
+    // Filter image pixels per sprite pixel
+    float filterStepX = cellWidth / float( range.x );
+    float filterStepY = cellHeight / float( range.y );
+
+    // Clip the footprint to the output once, rather than bounds checking every pixel
+    int x_first = max( 0, dst.bounds.x1 - start.x );
+    int y_first = max( 0, dst.bounds.y1 - start.y );
+    int x_last  = min( range.x, dst.bounds.x2 - 1 - start.x );
+    int y_last  = min( range.y, dst.bounds.y2 - 1 - start.y );
+
+    // Rows are the outer loop so the inner loop walks contiguous pixels with only per column terms left in it
+    for ( int y = y_first; y <= y_last; y++ ) {
+
+      int out_y = start.y + y;
+
+      // Row terms of the shape
+      float row_coverage = sprite_shape == SHAPE_BOX || sprite_shape == SHAPE_DISC ? 1.0f : shapeCoverage( out_y, ct_y, half_y, invHalfY );
+      float filterY = cell_origin.y + min( y * filterStepY, cellLimitY );
 
-        if ( dst.bounds.inside( out) ) {
+      for ( int x = x_first; x <= x_last; x++ ) {
 
-          // Exit if existing pixel is closer than current pixel
-          float existing_depth = dst( out.x, out.y, 3 );
-          if ( existing_depth > zdepth )
+        // Current output pixel
+        int2 out = int2( start.x + x, out_y );
+
+        // Exit if existing pixel is closer than current pixel
+        float existing_depth = dst( out.x, out.y, 3 );
+        if ( existing_depth > zdepth )
+          continue;
+
+        // Only pixels the sprite shape covers take the depth
+        if ( sprite_shape != SHAPE_BOX ) {
+          float coverage;
+          if ( sprite_shape == SHAPE_DISC )
+            coverage = discCoverage( float2( out.x, out.y ), float2( ct_x, ct_y ), float2( invHalfX, invHalfY ) );
+          else
+            coverage = row_coverage * shapeCoverage( out.x, ct_x, half_x, invHalfX );
+          if ( coverage <= 0.0f )
             continue;
+        }
+
+        // --- Filter Image Values ---
 
-          // --- Filter Image Values ---
-
-          if ( use_filter ) {
-            // Fit the new size to the filter image, exit if 0 alpha
-            float filterX = ( x / float( range.x ) ) * filterWidth;
-            float filterY = ( y / float( range.y ) ) * filterHeight;
-            float4 filter_value = bilinear( filterImage, filterX, filterY );
-            if ( filter_value.w <= 0.0f )
-              continue;
-          }
-
-          // Multiple passes
-          dst( out.x, out.y, 1 ) = out_vel.x;
-          dst( out.x, out.y, 2 ) = out_vel.y;
-          dst( out.x, out.y, 3 ) = zdepth;
+        if ( use_filter ) {
+          // Fit the new size to the filter image, exit if 0 alpha
+          float4 filter_value = bilinear( filterImage, cell_origin.x + min( x * filterStepX, cellLimitX ), filterY );
+          if ( filter_value.w <= 0.0f )
+            continue;
         }
+
+        // Multiple passes
+        dst( out.x, out.y, 1 ) = out_vel.x;
+        dst( out.x, out.y, 2 ) = out_vel.y;
+        dst( out.x, out.y, 3 ) = zdepth;
       }
     }
   
@@ -0,0 +1,161 @@
+'''
+Tests for the particle export in ParticleRenderer.py against a stub nuke module
+Run from the ParticleRenderer folder with : python -m unittest discover tests
+'''
+import json
+import os
+import shutil
+import sys
+import tempfile
+import types
+import unittest
+
+
+class Knob( object ):
+    def __init__( self, value='' ):
+        self._value = value
+
+    def value( self ):
+        return self._value
+
+    def setValue( self, value ):
+        self._value = value
+
+
+class Node( object ):
+    def __init__( self, name, **knobs ):
+        self.name = name
+        self.knobs = dict( ( key, Knob( value ) ) for key, value in knobs.items() )
+
+    def __getitem__( self, key ):
+        return self.knobs.setdefault( key, Knob() )
+
+    def fullName( self ):
+        return self.name
+
+
+def stubNuke():
+    '''
+    Return a stub nuke module that records saved scripts, executed frames and deleted nodes
+    '''
+    nuke = types.ModuleType( 'nuke' )
+    nuke.EXE_PATH = 'nuke'
+    nuke.saved = []
+    nuke.executed = []
+    nuke.deleted = []
+    nuke.opened = []
+    nuke.exportNode = Node( 'ParticleWrite1.Write1', file='user.####.exr', compression='PIZ Wavelet (32 scanlines)' )
+
+    def scriptSaveToTemp( path ):
+        nuke.saved.append( path )
+        with open( path, 'w' ) as f:
+            f.write( 'script' )
+
+    def execute( node, first, last ):
+        nuke.executed.append( ( node.name, first, last ) )
+        # Stand in for the Write, putting a file on disk for the frame
+        if node is nuke.exportNode:
+            path = node['file'].value().replace( '####', '%04d' % first )
+            with open( path, 'wb' ) as f:
+                f.write( b'x' * first )
+
+    nodes = types.ModuleType( 'nuke.nodes' )
+    for cls in ( 'Read', 'CurveTool', 'ParticleCache', 'ParticleToImage' ):
+        setattr( nodes, cls, lambda cls=cls, **knobs: Node( cls, **knobs ) )
+
+    nuke.scriptSaveToTemp = scriptSaveToTemp
+    nuke.scriptOpen = nuke.opened.append
+    nuke.toNode = lambda name: nuke.exportNode
+    nuke.execute = execute
+    nuke.delete = nuke.deleted.append
+    nuke.nodes = nodes
+    return nuke
+
+
+sys.modules[ 'nuke' ] = stubNuke()
+sys.path.insert( 0, os.path.join( os.path.dirname( os.path.abspath( __file__ ) ), '..' ) )
+import ParticleRenderer
+
+
+class ExportTest( unittest.TestCase ):
+
+    def setUp( self ):
+        self.nuke = ParticleRenderer.nuke = sys.modules[ 'nuke' ] = stubNuke()
+        self.folder = tempfile.mkdtemp()
+
+    def tearDown( self ):
+        shutil.rmtree( self.folder, ignore_errors=True )
+
+    def test_frameChunks( self ):
+        self.assertEqual( ParticleRenderer.frameChunks( 1, 10, 3 ), [ ( 1, 4 ), ( 5, 7 ), ( 8, 10 ) ] )
+        self.assertEqual( ParticleRenderer.frameChunks( 5, 6, 4 ), [ ( 5, 5 ), ( 6, 6 ) ] )
+
+    def test_framePath( self ):
+        self.assertEqual( ParticleRenderer.framePath( 'a.####.exr', 12 ), 'a.0012.exr' )
+        self.assertEqual( ParticleRenderer.framePath( 'a.%03d.exr', 7 ), 'a.007.exr' )
+
+    def test_exportFrames( self ):
+        commands = []
+        path = os.path.join( self.folder, 'out.####.exr' )
+
+        # Each worker writes the results json it was given as its last argument
+        def call( command ):
+            commands.append( command )
+            script, name, out, codec, first, last, results = command[3:]
+            self.assertTrue( os.path.exists( script ) )
+            with open( results, 'w' ) as f:
+                json.dump( [ [ frame, 0.5, 0.25, 100 + frame, True ] for frame in range( int( first ), int( last ) + 1 ) ], f )
+            return 0
+
+        results = ParticleRenderer.exportFrames( self.nuke.exportNode, path, 1, 5, codec='dwaa', workers=2, call=call )
+
+        self.assertEqual( results, [ ( frame, 0.5, 0.25, 100 + frame ) for frame in range( 1, 6 ) ] )
+        self.assertEqual( sorted( command[7:9] for command in commands ), [ [ '1', '3' ], [ '4', '5' ] ] )
+        for command in commands:
+            self.assertEqual( command[:2], [ 'nuke', '-t' ] )
+            self.assertEqual( command[4:7], [ 'ParticleWrite1.Write1', path, 'dwaa' ] )
+        # The user's node is left alone and the temporary script copy is cleaned up
+        self.assertEqual( self.nuke.exportNode['file'].value(), 'user.####.exr' )
+        self.assertEqual( self.nuke.exportNode['compression'].value(), 'PIZ Wavelet (32 scanlines)' )
+        self.assertFalse( os.path.exists( self.nuke.saved[0] ) )
+
+    def test_exportFramesFailure( self ):
+        path = os.path.join( self.folder, 'out.####.exr' )
+        self.assertRaises( RuntimeError, ParticleRenderer.exportFrames, self.nuke.exportNode, path, 1, 2, call=lambda command: 1 )
+        self.assertRaises( ValueError, ParticleRenderer.exportFrames, self.nuke.exportNode, path, 1, 2, codec='jpeg', call=lambda command: 0 )
+
+    def test_exportWorker( self ):
+        path = os.path.join( self.folder, 'out.####.exr' )
+        results_path = os.path.join( self.folder, 'results.json' )
+
+        ParticleRenderer.exportWorker( 'copy.nk', 'ParticleWrite1.Write1', path, 'zip', 3, 4, results_path )
+
+        # The copy is set up and rendered one frame at a time, then each frame is decoded by its own Read
+        self.assertEqual( self.nuke.opened, [ 'copy.nk' ] )
+        self.assertEqual( self.nuke.exportNode['compression'].value(), 'Zip (1 scanline)' )
+        self.assertEqual( self.nuke.exportNode['datatype'].value(), '32 bit float' )
+        self.assertEqual( self.nuke.executed, [ ( 'ParticleWrite1.Write1', 3, 3 ), ( 'ParticleWrite1.Write1', 4, 4 ),
+                                                ( 'CurveTool', 3, 3 ), ( 'CurveTool', 4, 4 ) ] )
+        self.assertEqual( [ node.name for node in self.nuke.deleted ], [ 'CurveTool', 'Read' ] * 2 )
+        with open( results_path ) as f:
+            results = json.load( f )
+        self.assertEqual( [ ( result[0], result[3] ) for result in results ], [ ( 3, 3 ), ( 4, 4 ) ] )
+
+    def test_exportWorkerRaw( self ):
+        self.nuke.exportNode = Node( 'ParticleWrite1.ParticleCache1' )
+        path = os.path.join( self.folder, 'out.####.nkpc' )
+        results_path = os.path.join( self.folder, 'results.json' )
+        for frame in ( 1, 2 ):
+            with open( ParticleRenderer.framePath( path, frame ), 'wb' ) as f:
+                f.write( b'x' * 10 )
+
+        ParticleRenderer.exportWorker( 'copy.nk', 'ParticleWrite1.ParticleCache1', path, 'raw', 1, 2, results_path )
+
+        # The raw cache has no exr settings, and reads back through a ParticleCache into a ParticleToImage
+        self.assertEqual( self.nuke.exportNode['file'].value(), path )
+        self.assertNotIn( 'compression', self.nuke.exportNode.knobs )
+        self.assertEqual( [ node.name for node in self.nuke.deleted ], [ 'CurveTool', 'ParticleToImage', 'ParticleCache' ] * 2 )
+
+
+if __name__ == '__main__':
+    unittest.main()